@@ -4,8 +4,11 @@
 // Read online: https://github.com/ocornut/imgui/tree/master/docs
 // websock hdrs
 #include <iostream>
+#include <algorithm>
+#include <deque>
+#include <random>
 #include <boost/asio/io_service.hpp>
-#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -17,6 +20,7 @@
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "imgui_internal.h"     // InputEventsQueue for idle mode
 #include <stdio.h>
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <GLES2/gl2.h>
@@ -24,6 +28,8 @@
 #include <GLFW/glfw3.h> // Will drag system OpenGL headers
 
 #include "nodom.hpp"
+#include "nd_ipc.hpp"
+#include <arrow/api.h>
 
 // [Win32] Our example includes a copy of glfw3.lib pre-compiled with VS2010 to maximize ease of testing and compatibility with old VS compilers.
 // To link with VS2010-era libraries, VS2015+ requires linking with legacy_stdio_definitions.lib, which we do using this pragma.
@@ -32,15 +38,35 @@
 #pragma comment(lib, "legacy_stdio_definitions")
 #endif
 
+// headless harness memory gauges
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <sys/resource.h>
+#endif
+
 static void glfw_error_callback(int error, const char* description)
 {
     fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
 
-static bool show_demo_window = true;
+// idle mode: set by GLFW when the window needs repainting, eg on expose
+static bool window_refresh = true;
+static void glfw_refresh_callback(GLFWwindow* window)
+{
+    window_refresh = true;
+}
+
 static ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
+void im_setup(NDContext& ctx);
+
 // int im_main(int argc, char** argv)
 GLFWwindow* im_start(NDContext& ctx)
 {
@@ -77,8 +103,26 @@ GLFWwindow* im_start(NDContext& ctx)
     if (window == nullptr)
         return window;
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1); // Enable vsync
+    // Enable vsync, unless breadboard.json asks the frame pacer to run free
+    glfwSwapInterval(ctx.get_breadboard_config().value("vsync", true) ? 1 : 0);
+    // imgui's GLFW backend doesn't install a refresh callback, so no chaining needed
+    glfwSetWindowRefreshCallback(window, glfw_refresh_callback);
+
+    im_setup(ctx);
+
+    // Setup Platform/Renderer backends
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init(glsl_version);
+
+    // Our state
+    return window;
+}
 
+
+// imgui context, style and fonts: everything but the window and
+// backends, so the headless harness can render without them
+void im_setup(NDContext& ctx)
+{
     nlohmann::json bbcfg(ctx.get_breadboard_config());
 
     // Setup Dear ImGui context
@@ -98,10 +142,6 @@ GLFWwindow* im_start(NDContext& ctx)
     style.ScaleAllSizes(scale);
     style.FontScaleDpi = scale;
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init(glsl_version);
-
     // Load Fonts
     // - If no fonts are loaded, dear imgui will use the default font. You can also load multiple fonts and use ImGui::PushFont()/PopFont() to select them.
     // - AddFontFromFileTTF() will return the ImFont* so you can store it if you need to select the font among multiple.
@@ -120,9 +160,6 @@ GLFWwindow* im_start(NDContext& ctx)
         IM_ASSERT(font != NULL);
         ctx.register_font(fit.key(), font);
     }
-
-    // Our state
-    return window;
 }
 
 
@@ -142,10 +179,8 @@ int im_render(GLFWwindow* window, NDContext& ctx)
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        // 1. Show the big demo window (Most of the sample code is in ImGui::ShowDemoWindow()! You can browse its code to learn more about Dear ImGui!).
-        if (show_demo_window)
-            ImGui::ShowDemoWindow(&show_demo_window);
-
+        // ShowDemoWindow is now toggled from the Footer, and rendered by NDContext
+        window_refresh = false;
         ctx.render();
 
         // Rendering
@@ -175,11 +210,21 @@ void im_end(GLFWwindow* window)
 }
 
 
-typedef websocketpp::client<websocketpp::config::asio_client> ws_client;
+typedef websocketpp::client<nd_ws_config> ws_client;
 typedef websocketpp::connection_hdl ws_handle;
 typedef websocketpp::lib::error_code    ws_error_code;
-typedef websocketpp::config::asio_client::message_type::ptr message_ptr;
-typedef boost::asio::deadline_timer     asio_timer;
+typedef nd_ws_config::message_type::ptr message_ptr;
+typedef boost::asio::steady_timer       asio_timer;
+typedef std::chrono::steady_clock       nd_clock;
+
+#define ND_FPS              60
+#define ND_IDLE_WAIT_MS     250
+#define ND_WS_DRAIN_BUDGET_US   4000    // per frame budget for inbound websock msgs
+#define ND_WS_BACKOFF_MIN_MS    250
+#define ND_WS_BACKOFF_MAX_MS    30000
+#define ND_WS_PING_MS           5000
+#define ND_WS_PONG_TIMEOUT_MS   5000
+#define ND_WS_OUTBOUND_MAX      1024    // msgs held while disconnected
 
 using websocketpp::lib::placeholders::_1;
 using websocketpp::lib::placeholders::_2;
@@ -190,98 +235,737 @@ using websocketpp::lib::bind;
 class NDWebSockClient {
 public:
     NDWebSockClient(const std::string& url, NDContext& c) : uri(url), ctx(c), window(im_start(c)) {
+        nlohmann::json bbcfg(ctx.get_breadboard_config());
+        idle = bbcfg.value("idle", true);
+        idle_wait_ms = bbcfg.value("idle_wait_ms", ND_IDLE_WAIT_MS);
+        int fps = bbcfg.value("fps", ND_FPS);
+        if (fps <= 0) fps = ND_FPS;
+        frame_period = std::chrono::duration_cast<nd_clock::duration>(std::chrono::nanoseconds(1000000000 / fps));
+        ctx.set_target_fps(fps);
+        ws_drain_budget = std::chrono::microseconds(bbcfg.value("ws_drain_budget_us", ND_WS_DRAIN_BUDGET_US));
+        backoff_min_ms = bbcfg.value("ws_backoff_min_ms", ND_WS_BACKOFF_MIN_MS);
+        backoff_max_ms = bbcfg.value("ws_backoff_max_ms", ND_WS_BACKOFF_MAX_MS);
+        ping_ms = bbcfg.value("ws_ping_ms", ND_WS_PING_MS);
+        pong_timeout_ms = bbcfg.value("ws_pong_timeout_ms", ND_WS_PONG_TIMEOUT_MS);
+        outbound_max = bbcfg.value("ws_outbound_max", ND_WS_OUTBOUND_MAX);
+        // permessage-deflate: offered unless switched off, and only
+        // applied to outbound msgs of at least deflate_min_bytes
+        nd_ws_deflate::offer_enabled() = bbcfg.value("ws_deflate", true);
+        deflate_min_bytes = bbcfg.value("ws_deflate_min_bytes", ND_WS_DEFLATE_MIN_BYTES);
+        // subprotocols offered at connect, in order of preference. A server
+        // that picks none of them gets JSON text as before.
+        nlohmann::json offers = bbcfg.value("ws_encodings", nlohmann::json::array({ "msgpack", "cbor" }));
+        for (auto& offer : offers) {
+            ws_offers.push_back(nd_subprotocols[nd_encoding(offer.get<std::string>())]);
+        }
         client.set_access_channels(websocketpp::log::alevel::all);
         client.clear_access_channels(websocketpp::log::alevel::frame_payload);
-        client.init_asio();
+        // websock I/O gets its own io_service and thread: see run
+        client.init_asio(&ws_io);
         client.set_message_handler(bind(&NDWebSockClient::on_message, this, &client, ::_1, ::_2));
         client.set_open_handler(bind(&NDWebSockClient::on_open, this, &client, ::_1));
         client.set_close_handler(bind(&NDWebSockClient::on_close, this, &client, ::_1));
         client.set_fail_handler(bind(&NDWebSockClient::on_fail, this, &client, ::_1));
+        client.set_pong_handler(bind(&NDWebSockClient::on_pong, this, ::_1, ::_2));
+        client.set_pong_timeout_handler(bind(&NDWebSockClient::on_pong_timeout, this, ::_1, ::_2));
     }
 
     void run() {
+        // py thread posts into our io_service when it has responses
+        ctx.register_response_callback(bind(&NDWebSockClient::post_server_responses, this));
+        // Websock I/O runs on its own thread, so reading and parsing a large
+        // QueryResult can't stall a frame. Parsed msgs come back to the render
+        // thread through the inbound SPSC ring. The work guard keeps ws_io
+        // running while there's no connection.
+        ws_work.reset(new boost::asio::io_service::work(ws_io));
+        reconnect_timer.reset(new asio_timer(ws_io));
+        ping_timer.reset(new asio_timer(ws_io));
         if (ctx.duck_app()) {
             ctx.register_ws_callback(bind(&NDWebSockClient::send, this, ::_1));
-            error_code.clear();
-            ws_client::connection_ptr con = client.get_connection(uri, error_code);
-            if (error_code) {
-                std::cerr << "NDWebSockClient: could not create connection because: "
-                                                    << error_code.message() << std::endl;
-            }
-            else {
-                // TODO: possible discard the websock conn
-                // client.connect(con);
+            ws_io.post(boost::bind(&NDWebSockClient::connect, this));
+        }
+        ws_thread = boost::thread([this]() { client.run(); });
+        // timer is a member: a stack timer is cancelled as soon as
+        // set_timer returns, so on_timeout fired straight away, every time
+        timer.reset(new asio_timer(render_io));
+        next_frame = nd_clock::now() + frame_period;
+        set_timer(next_frame);    // latest possible timer start
+        render_io.run();
+        // GUI closed: wind down websock I/O
+        ws_stopping = true;
+        ws_work.reset();
+        client.stop();
+        ws_thread.join();
+    }
+
+    // cpp thread: the connection belongs to the I/O thread, so post the write there
+    void send(const nlohmann::json& payload) {
+        ws_io.post([this, payload]() {
+            if (ws_state != ND_WS_OPEN) {
+                // held until on_open, like main.ts pending_websock_msgs, but
+                // bounded: past outbound_max the oldest msgs go
+                if (outbound.size() >= outbound_max) {
+                    outbound.pop_front();
+                    ws_status.dropped++;
+                    std::cerr << "NDWebSockClient::send: outbound full, dropped oldest" << std::endl;
+                }
+                outbound.push_back(payload);
+                publish_status();
+                return;
             }
+            send_now(payload);
+        });
+    }
+
+protected:
+    // websock I/O thread from here to on_pong_timeout
+
+    // encode for the negotiated subprotocol: binary frames for msgpack|cbor
+    void send_now(const nlohmann::json& payload) {
+        ws_error_code ec;
+        nd_encode(payload, ws_status.encoding, send_buf);
+        ws_status.bytes_out += send_buf.size();
+        // client.send(hdl, payload, op) marks every msg compressed, so we
+        // build the msg ourselves to keep small ones out of deflate. The
+        // flag is ignored if the server didn't accept permessage-deflate.
+        message_ptr msg = websocketpp::lib::make_shared<nd_ws_config::message_type>(
+            nd_ws_config::con_msg_manager_type::ptr(), nd_binary_encoding(ws_status.encoding) ?
+                websocketpp::frame::opcode::BINARY : websocketpp::frame::opcode::TEXT, send_buf.size());
+        msg->append_payload(send_buf);
+        msg->set_compressed(send_buf.size() >= deflate_min_bytes);
+        if (!msg->get_compressed()) nd_ws_deflate::stats().out_plain += send_buf.size();
+        client.send(handle, msg, ec);
+        if (ec) {
+            std::cerr << "NDWebSockClient::send: failed with " << ec.message() << std::endl;
         }
-        set_timer();    // latest possible timer start
-        client.run();   // this method just calls io_service.run()
     }
 
-    void send(const std::string& payload) {
+    void connect() {
+        if (ws_stopping) return;
         error_code.clear();
-        client.send(handle, payload, websocketpp::frame::opcode::TEXT, error_code);
+        ws_client::connection_ptr con = client.get_connection(uri, error_code);
         if (error_code) {
-            std::cerr << "NDWebSockClient::send: failed with " << error_code << std::endl;
+            std::cerr << "NDWebSockClient: could not create connection because: "
+                                                << error_code.message() << std::endl;
+            schedule_reconnect();
+            return;
+        }
+        con->set_pong_timeout(pong_timeout_ms);
+        for (auto& sp : ws_offers) {
+            con->add_subprotocol(sp, error_code);
+            if (error_code) {
+                std::cerr << "NDWebSockClient::connect: bad subprotocol " << sp << ": " << error_code.message() << std::endl;
+                error_code.clear();
+            }
         }
+        client.connect(con);
+        ws_state = ND_WS_CONNECTING;
+        ws_status.connect_attempts++;
+        publish_status();
+    }
+
+    // Exponential backoff with full jitter, so a fleet of breadboards
+    // dropped by one server restart don't all reconnect in lockstep
+    void schedule_reconnect() {
+        if (ws_stopping) return;
+        ws_state = ND_WS_DISCONNECTED;
+        long ceiling = backoff_min_ms << std::min(backoff_attempt, 16);
+        if (ceiling > backoff_max_ms || ceiling <= 0) ceiling = backoff_max_ms;
+        backoff_attempt++;
+        std::uniform_int_distribution<long> jitter(backoff_min_ms, std::max<long>(backoff_min_ms, ceiling));
+        long delay_ms = jitter(rng);
+        std::cout << "NDWebSockClient::schedule_reconnect: attempt " << backoff_attempt
+            << " in " << delay_ms << "ms" << std::endl;
+        reconnect_timer->expires_after(std::chrono::milliseconds(delay_ms));
+        reconnect_timer->async_wait([this](const boost::system::error_code& e) {
+            if (!e) connect();
+        });
+        publish_status();
+    }
+
+    void schedule_ping() {
+        ping_timer->expires_after(std::chrono::milliseconds(ping_ms));
+        ping_timer->async_wait([this](const boost::system::error_code& e) {
+            if (e || ws_state != ND_WS_OPEN) return;
+            ws_error_code ec;
+            ping_sent = nd_clock::now();
+            // pong or pong timeout comes back via the endpoint handlers
+            client.ping(handle, "nd", ec);
+            if (ec) {
+                std::cerr << "NDWebSockClient::ping: failed with " << ec.message() << std::endl;
+            }
+            schedule_ping();
+        });
+    }
+
+    void on_pong(ws_handle h, std::string payload) {
+        ws_status.rtt_us = std::chrono::duration_cast<std::chrono::microseconds>(nd_clock::now() - ping_sent).count();
+        publish_status();
+    }
+
+    void on_pong_timeout(ws_handle h, std::string payload) {
+        // half open TCP: the server has gone away without a FIN. Close,
+        // and on_close schedules the reconnect.
+        std::cerr << "NDWebSockClient::on_pong_timeout: closing hdl: " << h.lock().get() << std::endl;
+        ws_error_code ec;
+        client.close(h, websocketpp::close::status::going_away, "pong timeout", ec);
+    }
+
+    // hand a status snapshot to the render thread: drives db_status_color
+    void publish_status() {
+        ws_status.state = ws_state;
+        ws_status.queued = outbound.size();
+        ws_status.deflate = nd_ws_deflate::stats();
+        NDWSStatus status(ws_status);
+        render_io.post([this, status]() { ctx.set_ws_status(status); });
+        glfwPostEmptyEvent();
     }
 
 protected:
-    void set_timer() {
-        asio_timer timer(client.get_io_service());
-        timer.expires_from_now(boost::posix_time::millisec(16));
-        timer.async_wait(boost::bind(&NDWebSockClient::on_timeout, this, ::_1));
+    // absolute deadlines, so time spent rendering doesn't push the
+    // next frame back and drift can't accumulate
+    void set_timer(nd_clock::time_point deadline) {
+        timer->expires_at(deadline);
+        timer->async_wait(boost::bind(&NDWebSockClient::on_timeout, this, ::_1));
     }
 
     void on_timeout(const boost::system::error_code& e) {
+        if (e == boost::asio::error::operation_aborted) return;
+        if (!idle || frame_due()) {
+            if (paced_idle) {
+                // back from idle: restart the cadence rather than
+                // count the idle stretch as skipped frames
+                next_frame = nd_clock::now();
+                paced_idle = false;
+            }
+            if (render_frame()) {
+                schedule_next_frame();
+            }
+            return;
+        }
+        // Idle: nothing to draw, so block in GLFW rather than spin. We wake
+        // on input, on glfwPostEmptyEvent from post_server_responses or the
+        // websock I/O thread, or after idle_wait_ms.
+        glfwWaitEventsTimeout(idle_wait_ms / 1000.0);
+        ctx.count_idle_wait();
+        paced_idle = true;
+        last_frame = nd_clock::time_point();
+        // due now: let any handlers posted meanwhile run before we check again
+        set_timer(nd_clock::now());
+    }
+
+    void schedule_next_frame() {
+        next_frame += frame_period;
+        nd_clock::time_point now(nd_clock::now());
+        if (next_frame <= now) {
+            // we overran one or more deadlines: skip them, don't
+            // try to catch up with a burst of back to back frames
+            std::int64_t skipped = (now - next_frame) / frame_period + 1;
+            next_frame += frame_period * skipped;
+            ctx.count_skipped_frames(skipped);
+        }
+        set_timer(next_frame);
+    }
+
+    // idle mode: do we have a reason to render?
+    bool frame_due() {
+        // GLFW input lands in imgui's input queue via the backend callbacks
+        return window_refresh || glfwWindowShouldClose(window)
+            || ImGui::GetCurrentContext()->InputEventsQueue.Size > 0
+            || !inbound.empty()
+            || ctx.needs_frame();
+    }
+
+    // cpp thread: hand inbound websock msgs to the context, stopping once
+    // the frame's budget is spent. Any backlog keeps frames coming, so a
+    // burst is spread over frames rather than stalling one.
+    void drain_ws_messages() {
+        // clear before draining so a push from here on wakes us again
+        ws_wake_posted = false;
+        if (inbound.empty()) return;
+        nd_clock::time_point deadline(nd_clock::now() + ws_drain_budget);
+        std::size_t backlog = inbound.size();
+        std::uint64_t drained = 0;
+        while (inbound.pop(ws_msg)) {
+            ctx.on_duck_event(ws_msg);
+            drained++;
+            if (nd_clock::now() >= deadline) break;
+        }
+        if (!inbound.empty()) ctx.request_redraw();
+        ctx.record_ws_drain(drained, backlog, ws_full_waits);
+    }
+
+    bool render_frame() {
+        // frame to frame interval for the Footer histogram, not
+        // counting the gap back from idle
+        nd_clock::time_point start(nd_clock::now());
+        if (last_frame != nd_clock::time_point()) {
+            ctx.record_frame_time(std::chrono::duration_cast<std::chrono::microseconds>(start - last_frame).count());
+        }
+        last_frame = start;
+        drain_ws_messages();
+        ctx.dispatch_server_responses();
         // if im_render returns false someone has closed the app via GUI
         if (!im_render(window, ctx)) {
             im_end(window);                 // imgui finalisation
             ctx.set_done(true);             // py thread loop exit
-            client.get_io_service().stop(); // asio finalisation
+            render_io.stop();               // asio finalisation; run stops websock I/O
+            return false;
         }
-        else {
-            set_timer();
-            // are there any responses from the python side?
-            while (!python_responses.empty()) {
-                python_responses.pop();
-                std::cerr << "NDWebSockClient::on_timeout: python_responses not empty!" << std::endl;
-            }
-            ctx.get_server_responses(python_responses);
-            ctx.dispatch_server_responses(python_responses);
+        return true;
+    }
+
+    // py thread: hand off to the asio loop. We only post when there is
+    // no dispatch already pending, so a busy py thread can't flood the Q
+    void post_server_responses() {
+        if (!responses_posted.exchange(true)) {
+            render_io.post(boost::bind(&NDWebSockClient::on_server_responses, this));
+            // wake the cpp thread if it's idle in glfwWaitEventsTimeout
+            glfwPostEmptyEvent();
         }
     }
 
+    // cpp thread: stage responses as soon as they land, so the lanes'
+    // rings drain and DataChanges merge per key. They're dispatched at
+    // the start of the next frame, which the redraw request brings
+    // forward, so per frame apply cost is bounded by the distinct keys
+    // staged, not by the inbound rate.
+    void on_server_responses() {
+        responses_posted = false;
+        ctx.pull_server_responses();
+    }
+
+    // websock I/O thread: parse here, off the render thread
     void on_message(ws_client* c, ws_handle h, message_ptr msg_ptr) {
-        std::string payload(msg_ptr->get_payload());
-        std::cout << "NDWebSockClient::on_message: hdl( " << h.lock().get()
-            << ") msg: " << payload << std::endl;
+        const static char* method = "NDWebSockClient::on_message: ";
+        const std::string& payload(msg_ptr->get_payload());
+        // size only: logging a 50MB payload costs more than parsing it
+        std::cout << method << "hdl(" << h.lock().get() << ") " << payload.size() << " bytes" << std::endl;
+        if (msg_ptr->get_opcode() == websocketpp::frame::opcode::BINARY) {
+            NDIPCFrame frame;
+            if (nd_ipc_frame(payload.data(), payload.size(), frame)) {
+                on_ipc_frame(msg_ptr, frame);
+                return;
+            }
+        }
+        // BINARY frames carry the negotiated encoding; TEXT is always JSON,
+        // so a server can still fall back to text for any msg it likes
+        NDEncoding enc = msg_ptr->get_opcode() == websocketpp::frame::opcode::BINARY ? ws_status.encoding : ND_ENC_JSON;
+        if (msg_ptr->get_opcode() == websocketpp::frame::opcode::BINARY && !nd_binary_encoding(enc)) {
+            std::cerr << method << "binary frame but no binary subprotocol, dropped" << std::endl;
+            return;
+        }
+        nlohmann::json msg_json;
+        nd_clock::time_point start(nd_clock::now());
+        try {
+            msg_json = nd_decode(payload.data(), payload.size(), enc);
+        }
+        catch (nlohmann::json::exception& ex) {
+            std::cerr << method << ex.what() << std::endl;
+            return;
+        }
+        ws_status.decode_us += std::chrono::duration_cast<std::chrono::microseconds>(nd_clock::now() - start).count();
+        ws_status.msgs_in++;
+        ws_status.bytes_in += payload.size();
+        push_inbound(std::move(msg_json));
+    }
 
-        nlohmann::json msg_json = nlohmann::json::parse(payload);
-        ctx.on_duck_event(msg_json);
+    // websock I/O thread: an Arrow IPC result frame. Batches are read in
+    // place over the payload, staged for the render thread like the
+    // lanes' batches, and announced with the same QueryResultBatch and
+    // QueryResultEnd msgs, so on_duck_event registers the result in the
+    // data cache as <query_id>_result for the table widgets.
+    void on_ipc_frame(message_ptr msg_ptr, const NDIPCFrame& frame) {
+        const static char* method = "NDWebSockClient::on_ipc_frame: ";
+        const std::string& payload(msg_ptr->get_payload());
+        NDIPCStream& stream(ipc_streams[frame.query_id]);
+        ipc_batches.clear();
+        nd_clock::time_point start(nd_clock::now());
+        // msg_ptr is the owner: the payload outlives the socket's read
+        // buffers for as long as any batch refers to it
+        arrow::Status status = nd_ipc_read(payload.data(), payload.size(), frame, msg_ptr, ipc_batches);
+        ws_status.decode_us += std::chrono::duration_cast<std::chrono::microseconds>(nd_clock::now() - start).count();
+        ws_status.msgs_in++;
+        ws_status.bytes_in += payload.size();
+        ws_status.ipc_frames++;
+        for (auto& batch : ipc_batches) {
+            stream.rows += batch->num_rows();
+            ws_status.ipc_rows += batch->num_rows();
+            push_inbound({ {"nd_type", "QueryResultBatch"}, {"query_id", frame.query_id},
+                            {"batch", ctx.stage_batch(batch)}, {"seq", stream.batches++} });
+        }
+        if (!status.ok() || frame.flags & ND_IPC_LAST) {
+            nlohmann::json end_j = { {"nd_type", "QueryResultEnd"}, {"query_id", frame.query_id},
+                                        {"rows", stream.rows}, {"batches", stream.batches} };
+            if (!status.ok()) {
+                std::cerr << method << frame.query_id << ": " << status.ToString() << std::endl;
+                end_j["error"] = status.ToString();
+            }
+            std::cout << method << frame.query_id << ": " << stream.rows << " rows in " << stream.batches << " batches" << std::endl;
+            ipc_streams.erase(frame.query_id);
+            push_inbound(std::move(end_j));
+        }
+    }
+
+    // websock I/O thread
+    void push_inbound(nlohmann::json&& msg_json) {
+        // a full ring holds up the I/O thread, which pushes back on the
+        // server via TCP rather than dropping msgs
+        while (!inbound.push(std::move(msg_json))) {
+            if (ws_stopping) return;
+            ws_full_waits++;
+            wake_render_thread();
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+        }
+        wake_render_thread();
+    }
+
+    // websock I/O thread: one wake per drain, not per msg
+    void wake_render_thread() {
+        if (!ws_wake_posted.exchange(true)) {
+            glfwPostEmptyEvent();
+        }
     }
 
 
     void on_open(ws_client* c, ws_handle h) {
         std::cout << "NDWebSockClient::on_open: hdl:" << h.lock().get() << std::endl;
         handle = h;
+        ws_state = ND_WS_OPEN;
+        // empty if the server chose none of our offers
+        ws_client::connection_ptr con = c->get_con_from_hdl(h);
+        ws_status.encoding = nd_encoding(con->get_subprotocol());
+        std::cout << "NDWebSockClient::on_open: encoding " << nd_encoding_names[ws_status.encoding] << std::endl;
+        ws_status.connects++;
+        backoff_attempt = 0;
+        // flush msgs held while disconnected in one pass, in order
+        std::cout << "NDWebSockClient::on_open: flushing " << outbound.size() << " msgs" << std::endl;
+        while (!outbound.empty()) {
+            send_now(outbound.front());
+            outbound.pop_front();
+        }
+        schedule_ping();
+        publish_status();
     }
 
     void on_close(ws_client* c, ws_handle h) {
         std::cout << "NDWebSockClient::on_close: hdl: " << h.lock().get() << std::endl;
+        handle.reset();
+        ping_timer->cancel();
+        schedule_reconnect();
     }
 
     void on_fail(ws_client* c, ws_handle h) {
         std::cout << "NDWebSockClient::on_fail: hdl: " << h.lock().get() << std::endl;
+        handle.reset();
+        ping_timer->cancel();
+        schedule_reconnect();
     }
 
 private:
     std::string     uri;
+    boost::asio::io_service     render_io;  // frame timer and py responses
+    boost::asio::io_service     ws_io;      // websock I/O thread
+    std::unique_ptr<boost::asio::io_service::work> ws_work;
+    boost::thread               ws_thread;
     ws_client       client;
     ws_handle       handle;
     ws_error_code   error_code;
     NDContext&      ctx;
     GLFWwindow*     window;
-    std::queue<nlohmann::json>  python_responses;
+    boost::atomic<bool>         responses_posted{ false };
+    std::unique_ptr<asio_timer> timer;
+    nd_clock::duration          frame_period;
+    nd_clock::time_point        next_frame;     // deadline for the next paced frame
+    nd_clock::time_point        last_frame;     // start of the last frame rendered
+    bool                        paced_idle = false;
+    bool                        idle = true;
+    int                         idle_wait_ms = ND_IDLE_WAIT_MS;
+    // websock I/O thread -> cpp thread
+    NDRingBuffer<nlohmann::json>    inbound;
+    nlohmann::json                  ws_msg;     // drain scratch
+    std::chrono::microseconds       ws_drain_budget{ ND_WS_DRAIN_BUDGET_US };
+    boost::atomic<bool>             ws_wake_posted{ false };
+    boost::atomic<bool>             ws_stopping{ false };
+    boost::atomic<std::uint64_t>    ws_full_waits{ 0 };
+    // connection manager: websock I/O thread only
+    NDWSState                       ws_state = ND_WS_DISCONNECTED;
+    NDWSStatus                      ws_status;
+    std::deque<nlohmann::json>      outbound;   // held while not open, encoded on send
+    std::vector<std::string>        ws_offers;  // subprotocols, preferred first
+    std::string                     send_buf;   // encode scratch
+    std::size_t                     deflate_min_bytes = ND_WS_DEFLATE_MIN_BYTES;
+    // Arrow IPC results arriving as several frames: websock I/O thread only
+    struct NDIPCStream {
+        std::int64_t    rows = 0;
+        std::int64_t    batches = 0;
+    };
+    std::unordered_map<std::string, NDIPCStream>        ipc_streams;
+    std::vector<std::shared_ptr<arrow::RecordBatch>>    ipc_batches;    // scratch
+    std::size_t                     outbound_max = ND_WS_OUTBOUND_MAX;
+    std::unique_ptr<asio_timer>     reconnect_timer;
+    std::unique_ptr<asio_timer>     ping_timer;
+    nd_clock::time_point            ping_sent;
+    int                             backoff_attempt = 0;
+    long                            backoff_min_ms = ND_WS_BACKOFF_MIN_MS;
+    long                            backoff_max_ms = ND_WS_BACKOFF_MAX_MS;
+    long                            ping_ms = ND_WS_PING_MS;
+    long                            pong_timeout_ms = ND_WS_PONG_TIMEOUT_MS;
+    std::mt19937                    rng{ std::random_device{}() };
+};
+
+
+// resident set in KB: now, or the process peak
+static std::int64_t nd_working_set_kb(bool peak)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return static_cast<std::int64_t>((peak ? pmc.PeakWorkingSetSize : pmc.WorkingSetSize) / 1024);
+#else
+    if (peak) {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss;
+    }
+    long pages = 0;
+    long resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(statm);
+    return resident * 4;
+#endif
+}
+
+
+// Headless harness: with a "headless" object in breadboard.json, main runs
+// benchmarks against the real NDServer and NDContext, with no window and
+// no websocket, then exits. The py thread and lanes start as usual, so the
+// test dir's py module must still import.
+//  "setup"     DB requests dispatched once, in order, before timing, eg a
+//              ParquetScan creating the view the queries read
+//  "queries"   DB requests timed from dispatch to QueryResultEnd, "runs"
+//              times each
+// Run it once with "native_duck":false and once with true to compare the
+// py and native duck paths. Peak working set is per process, hence a
+// process per path.
+//  "frames"    frames to render after any queries, with an imgui context
+//              but no window or backends, timing NewFrame, NDContext::render
+//              and ImGui::Render over the test dir's layout. nd_bench layout
+//              writes a layout of as many widgets as you like.
+//  "width", "height"   display size for frames, 1280x720 by default
+//  "table_rows"    eg [10000, 100000, 1000000]: for each count, stream a
+//              synthetic result of that many rows into <table_query_id>_result,
+//              "headless_table_result" by default, and time frames scrolling
+//              the Table bound to it "wheel" notches a frame, 10 by default.
+//              nd_bench table_layout writes a layout with that Table.
+#define ND_HEADLESS_TIMEOUT_S   600
+
+class NDHeadless {
+public:
+    NDHeadless(NDContext& c, const nlohmann::json& cfg) : ctx(c), config(cfg) {
+        timeout = std::chrono::seconds(config.value("timeout_s", ND_HEADLESS_TIMEOUT_S));
+    }
+
+    int run() {
+        // py thread: as NDWebSockClient::post_server_responses, but
+        // there's no io_service here, so wake pump instead
+        ctx.register_response_callback([this]() {
+            {
+                boost::lock_guard<boost::mutex> lock(mutex);
+                posted = true;
+            }
+            cond.notify_one();
+        });
+        bool ok = true;
+        if (config.contains("setup") || config.contains("queries")) ok = bench_queries();
+        if (ok && config.value("frames", 0) > 0) ok = bench_frames();
+        ctx.set_done(true);
+        return ok ? 0 : 1;
+    }
+
+protected:
+    // cpp thread: wait for the py thread to post, then dispatch
+    void pump() {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            cond.wait_for(lock, boost::chrono::milliseconds(ND_IDLE_WAIT_MS), [this] { return posted; });
+            posted = false;
+        }
+        ctx.dispatch_server_responses();
+    }
+
+    // dispatch and pump until a new result for the query_id completes
+    std::shared_ptr<NDResult> run_query(const nlohmann::json& q) {
+        const static char* method = "NDHeadless::run_query: ";
+        const std::string qid(q.value("query_id", ""));
+        std::shared_ptr<NDResult> last(ctx.find_result(qid));
+        std::uint64_t last_handle = last ? last->handle : 0;
+        last.reset();
+        ctx.dispatch_query(q.value("nd_type", "Query"), q.value("sql", ""), qid);
+        nd_clock::time_point deadline(nd_clock::now() + timeout);
+        while (nd_clock::now() < deadline) {
+            pump();
+            std::shared_ptr<NDResult> result(ctx.find_result(qid));
+            if (result && result->handle != last_handle && result->complete) return result;
+        }
+        std::cerr << method << qid << ": no QueryResultEnd after " << timeout.count() << "s" << std::endl;
+        return nullptr;
+    }
+
+    bool bench_queries() {
+        const static char* method = "NDHeadless::bench_queries: ";
+        nlohmann::json bbcfg(ctx.get_breadboard_config());
+        const char* path = bbcfg.value("native_duck", false) ? "native" : "py";
+        // setup requests share duck0 with the queries, so they're done
+        // once a trailing Query on the same lane completes
+        for (auto& q : config.value("setup", nlohmann::json::array())) {
+            ctx.dispatch_query(q.value("nd_type", "ParquetScan"), q.value("sql", ""), q.value("query_id", ""));
+        }
+        if (!run_query({ {"nd_type", "Query"}, {"sql", "select 1;"}, {"query_id", "headless_sync"} })) return false;
+        int runs = std::max(1, config.value("runs", 1));
+        for (auto& q : config.value("queries", nlohmann::json::array())) {
+            for (int i = 0; i < runs; i++) {
+                std::int64_t before_kb = nd_working_set_kb(false);
+                std::shared_ptr<NDResult> result(run_query(q));
+                if (!result) return false;
+                std::int64_t after_kb = nd_working_set_kb(false);
+                auto ms = [&](std::chrono::steady_clock::time_point t) {
+                    return std::chrono::duration_cast<std::chrono::milliseconds>(t - result->dispatched).count();
+                };
+                std::cout << method << path << " " << result->query_id << " run " << i << ": " << result->num_rows
+                    << " rows in " << result->batches.size() << " batches, first row "
+                    << (result->batches.empty() ? 0 : ms(result->first_row)) << "ms, complete " << ms(result->completed)
+                    << "ms, working set " << before_kb / 1024 << "MB -> " << after_kb / 1024 << "MB" << std::endl;
+            }
+        }
+        std::cout << method << path << " peak working set " << nd_working_set_kb(true) / 1024 << "MB" << std::endl;
+        return true;
+    }
+
+    // one frame as im_render would do it, minus the backends and GL. Home
+    // fills the display, as in a maximised window. wheel scrolls whatever
+    // is under the display centre, eg a Table, down that many notches.
+    std::int64_t render_headless_frame(float wheel) {
+        ImGuiIO& io = ImGui::GetIO();
+        if (wheel) {
+            io.AddMousePosEvent(io.DisplaySize.x / 2, io.DisplaySize.y / 2);
+            io.AddMouseWheelEvent(0.0f, -wheel);
+        }
+        nd_clock::time_point start(nd_clock::now());
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0, 0));
+        ImGui::SetNextWindowSize(io.DisplaySize);
+        ctx.render();
+        ImGui::Render();
+        return std::chrono::duration_cast<std::chrono::microseconds>(nd_clock::now() - start).count();
+    }
+
+    void time_frames(const std::string& what, int frames, float wheel) {
+        const static char* method = "NDHeadless::time_frames: ";
+        // imgui settles window sizes and layout over the first frames
+        for (int i = 0; i < ND_REDRAW_FRAMES; i++) render_headless_frame(0.0f);
+        std::vector<std::int64_t> samples;
+        samples.reserve(frames);
+        std::int64_t total_us = 0;
+        for (int i = 0; i < frames; i++) {
+            samples.push_back(render_headless_frame(wheel));
+            total_us += samples.back();
+        }
+        const ImDrawData* draw_data = ImGui::GetDrawData();
+        std::sort(samples.begin(), samples.end());
+        std::cout << method << what << ": " << frames << " frames of " << ctx.node_count() << " nodes, "
+            << (draw_data ? draw_data->TotalVtxCount : 0) << " vertices: p50 " << samples[samples.size() / 2]
+            << "us, p99 " << samples[(samples.size() - 1) * 99 / 100] << "us, max " << samples.back()
+            << "us, " << (total_us ? frames * 1000000LL / total_us : 0) << " fps" << std::endl;
+    }
+
+    // a synthetic result: one column per common render_table formatter
+    static arrow::Result<std::shared_ptr<arrow::RecordBatch>> table_batch(std::int64_t first, std::int64_t rows) {
+        static const char* tickers[] = { "VOD.L", "BARC.L", "HSBA.L", "BP.L", "SHEL.L", "AZN.L" };
+        std::shared_ptr<arrow::DataType> ts_type(arrow::timestamp(arrow::TimeUnit::MICRO));
+        std::shared_ptr<arrow::DataType> dec_type(arrow::decimal128(18, 4));
+        arrow::Int64Builder id;
+        arrow::StringBuilder ticker;
+        arrow::DoubleBuilder px;
+        arrow::Decimal128Builder notional(dec_type);
+        arrow::TimestampBuilder ts(ts_type, arrow::default_memory_pool());
+        for (std::int64_t i = first; i < first + rows; i++) {
+            ARROW_RETURN_NOT_OK(id.Append(i));
+            ARROW_RETURN_NOT_OK(ticker.Append(tickers[i % 6]));
+            ARROW_RETURN_NOT_OK(px.Append(100.0 + (i % 10000) * 0.01));
+            ARROW_RETURN_NOT_OK(notional.Append(arrow::Decimal128(i * 12345)));
+            // 2024-06-03T08:00:00Z plus a ms per row
+            ARROW_RETURN_NOT_OK(ts.Append(1717401600000000LL + i * 1000));
+        }
+        std::vector<std::shared_ptr<arrow::Array>> columns(5);
+        ARROW_RETURN_NOT_OK(id.Finish(&columns[0]));
+        ARROW_RETURN_NOT_OK(ticker.Finish(&columns[1]));
+        ARROW_RETURN_NOT_OK(px.Finish(&columns[2]));
+        ARROW_RETURN_NOT_OK(notional.Finish(&columns[3]));
+        ARROW_RETURN_NOT_OK(ts.Finish(&columns[4]));
+        std::shared_ptr<arrow::Schema> schema(arrow::schema({ arrow::field("id", arrow::int64()),
+            arrow::field("ticker", arrow::utf8()), arrow::field("px", arrow::float64()),
+            arrow::field("notional", dec_type), arrow::field("ts", ts_type) }));
+        return arrow::RecordBatch::Make(schema, rows, columns);
+    }
+
+    // stream a synthetic result in as on_ipc_frame would, so the layout's
+    // Table on <query_id>_result shows it
+    bool load_table(const std::string& qid, std::int64_t rows) {
+        const static char* method = "NDHeadless::load_table: ";
+        const std::int64_t batch_rows = 65536;
+        std::int64_t seq = 0;
+        for (std::int64_t first = 0; first < rows; first += batch_rows) {
+            arrow::Result<std::shared_ptr<arrow::RecordBatch>> batch(table_batch(first, std::min(batch_rows, rows - first)));
+            if (!batch.ok()) {
+                std::cerr << method << batch.status().ToString() << std::endl;
+                return false;
+            }
+            nlohmann::json batch_j = { {"nd_type", "QueryResultBatch"}, {"query_id", qid},
+                                        {"batch", ctx.stage_batch(*batch)}, {"seq", seq++} };
+            ctx.on_duck_event(batch_j);
+        }
+        nlohmann::json end_j = { {"nd_type", "QueryResultEnd"}, {"query_id", qid}, {"rows", rows}, {"batches", seq} };
+        ctx.on_duck_event(end_j);
+        return true;
+    }
+
+    bool bench_frames() {
+        const int frames = config.value("frames", 0);
+        im_setup(ctx);
+        ImGuiIO& io = ImGui::GetIO();
+        io.IniFilename = nullptr;
+        io.DisplaySize = ImVec2(config.value("width", 1280.0f), config.value("height", 720.0f));
+        io.DeltaTime = 1.0f / ND_FPS;
+        // no renderer backend to build the font atlas, so build it here
+        unsigned char* pixels = nullptr;
+        int tex_w = 0;
+        int tex_h = 0;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &tex_w, &tex_h);
+        bool ok = true;
+        nlohmann::json table_rows(config.value("table_rows", nlohmann::json::array()));
+        if (table_rows.empty()) {
+            time_frames("layout", frames, 0.0f);
+        }
+        const std::string qid(config.value("table_query_id", "headless_table"));
+        const float wheel = config.value("wheel", 10.0f);
+        for (auto& rows : table_rows) {
+            if (!(ok = load_table(qid, rows.get<std::int64_t>()))) break;
+            time_frames(std::to_string(rows.get<std::int64_t>()) + " rows", frames, wheel);
+        }
+        ImGui::DestroyContext();
+        return ok;
+    }
+
+private:
+    NDContext&                  ctx;
+    nlohmann::json              config;
+    std::chrono::seconds        timeout;
+    boost::mutex                mutex;
+    boost::condition_variable   cond;
+    bool                        posted = false;
 };
 
 
@@ -289,6 +973,12 @@ int main(int argc, char* argv[]) {
     std::string uri = "ws://localhost:8892/api/websock";
     NDServer server(argc, argv);
     NDContext ctx(server);
+    // benchmarks in place of the GUI: see NDHeadless
+    nlohmann::json headless(ctx.get_breadboard_config().value("headless", nlohmann::json()));
+    if (headless.is_object()) {
+        NDHeadless bench(ctx, headless);
+        return bench.run();
+    }
     try {
         NDWebSockClient ws_client(uri, ctx);
         ws_client.run();
@@ -0,0 +1,1142 @@
+// nd_bench: console benchmarks for breadboard's hot paths. Nothing here
+// needs a window or py, so numbers can be taken before and after a change
+// without standing up the GUI and a backend. Run with no args for every
+// bench, or name them, each optionally followed by a count:
+//
+//  nd_bench [ring [msgs]] [post [msgs]] [cache [keys]] [inbound [msgs]] [codec [rows]]
+//           [patch [elements]] [deflate [rows]] [ipc [rows]] [ws] [jitter [mb]]
+//           [layout [widgets]] [table_layout]
+//  nd_bench serve [port] [drop_ms] [nopong]
+//
+// ipc needs arrow, deflate zlib, and ws, jitter and serve websocketpp:
+// ND_BENCH_ARROW, ND_BENCH_ZLIB and ND_BENCH_WS switch them in, and
+// nd_bench.vcxproj defines all three. Results go to stdout, one line per
+// measurement, so runs can be diffed.
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include "json.hpp"
+#include "nd_ring.hpp"
+#include "nd_cache.hpp"
+#include "nd_codec.hpp"
+#include "nd_inbound.hpp"
+#ifdef ND_BENCH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ND_BENCH_ARROW
+#include "nd_ipc.hpp"
+#include <arrow/api.h>
+#include <arrow/io/memory.h>
+#include <arrow/ipc/writer.h>
+#endif
+#ifdef ND_BENCH_WS
+#include "nd_deflate.hpp"
+#include <websocketpp/client.hpp>
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+#endif
+
+typedef std::chrono::steady_clock nd_clock;
+
+static std::int64_t nd_elapsed_us(nd_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(nd_clock::now() - start).count();
+}
+
+static std::int64_t nd_elapsed_ns(nd_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(nd_clock::now() - start).count();
+}
+
+// stands in for work that holds a thread without sleeping, eg a py call
+static void nd_spin_us(int us)
+{
+    nd_clock::time_point end(nd_clock::now() + std::chrono::microseconds(us));
+    while (nd_clock::now() < end) {}
+}
+
+// reorders samples
+static std::int64_t nd_percentile(std::vector<std::int64_t>& samples, double p)
+{
+    if (samples.empty()) return 0;
+    auto nth = samples.begin() + static_cast<std::size_t>(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+}
+
+static void nd_report_samples(const char* bench, const std::string& what, std::vector<std::int64_t>& samples, const char* unit)
+{
+    std::int64_t p50 = nd_percentile(samples, 0.5);
+    std::int64_t p99 = nd_percentile(samples, 0.99);
+    std::int64_t max = nd_percentile(samples, 1.0);
+    std::cout << bench << ": " << what << " p50 " << p50 << unit << ", p99 " << p99 << unit
+        << ", max " << max << unit << " (" << samples.size() << " samples)" << std::endl;
+}
+
+// a QueryResult row: trade like, 10 columns
+static nlohmann::json nd_bench_row(std::int64_t i)
+{
+    static const char* sides[] = { "BUY", "SELL" };
+    static const char* venues[] = { "XLON", "XPAR", "XETR", "XAMS" };
+    char ticker[16];
+    std::snprintf(ticker, sizeof(ticker), "T%05lld", static_cast<long long>(i % 50000));
+    double px = 100.0 + (i % 1000) * 0.01;
+    return nlohmann::json::array({ i, ticker, px, (i % 97) * 100, sides[i % 2], venues[i % 4],
+        "2024-06-03T08:00:00.000000Z", px - 0.01, px + 0.01, (i % 3) != 0 });
+}
+
+static nlohmann::json nd_bench_rows(std::int64_t n)
+{
+    nlohmann::json rows = nlohmann::json::array();
+    for (std::int64_t i = 0; i < n; i++) rows.push_back(nd_bench_row(i));
+    return rows;
+}
+
+
+// ring: NDServer's to_python hand off. The cpp thread enqueues DataChanges
+// at a steady rate and wakes the py thread through to_mutex and to_cond.
+// The py thread spends work_us per msg, standing in for on_data_change.
+// Three hand offs:
+//  baseline    the pre ring python_thread: std::queue under to_mutex, with
+//              to_mutex held while the py thread works through the queue,
+//              so an enqueue waits out whatever msg is being serviced
+//  locked      std::queue under its own mutex, held only to push or pop
+//  ring        NDRingBuffer with a predicate wait, as lane_loop does now
+// Reported: the cpp thread's enqueue time, which is what a frame pays,
+// and enqueue to dequeue latency.
+struct NDBenchItem {
+    nlohmann::json          msg;
+    nd_clock::time_point    stamp;
+};
+
+class NDLockedQueue {
+public:
+    bool push(NDBenchItem&& item) {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        q.push(std::move(item));
+        return true;
+    }
+    bool pop(NDBenchItem& item) {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if (q.empty()) return false;
+        item = std::move(q.front());
+        q.pop();
+        return true;
+    }
+    bool empty() {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        return q.empty();
+    }
+
+private:
+    boost::mutex                mutex;
+    std::queue<NDBenchItem>     q;
+};
+
+template <typename Q>
+static void bench_handoff(const char* name, Q& q, bool baseline, int rate, int count, int work_us)
+{
+    boost::mutex to_mutex;
+    boost::condition_variable to_cond;
+    boost::atomic<bool> done(false);
+    std::vector<std::int64_t> latency;
+    std::vector<std::int64_t> enqueue;
+    latency.reserve(count);
+    enqueue.reserve(count);
+    boost::thread consumer([&]() {
+        NDBenchItem item;
+        while (true) {
+            boost::unique_lock<boost::mutex> lock(to_mutex);
+            to_cond.wait(lock, [&] { return done || !q.empty(); });
+            if (!baseline) lock.unlock();
+            while (q.pop(item)) {
+                latency.push_back(nd_elapsed_us(item.stamp));
+                nd_spin_us(work_us);
+            }
+            if (done && q.empty()) return;
+        }
+    });
+    const nlohmann::json msg = { {"nd_type", "DataChange"}, {"cache_key", "px"}, {"old_value", 1.0}, {"new_value", 2.0} };
+    const nd_clock::duration period(std::chrono::nanoseconds(1000000000 / rate));
+    nd_clock::time_point next(nd_clock::now());
+    for (int i = 0; i < count; i++) {
+        // spin to the next send: sleep granularity is too coarse at 10k/s
+        next += period;
+        while (nd_clock::now() < next) boost::this_thread::yield();
+        NDBenchItem item{ msg, nd_clock::now() };
+        nd_clock::time_point start(item.stamp);
+        if (baseline) {
+            boost::lock_guard<boost::mutex> lock(to_mutex);
+            q.push(std::move(item));
+        }
+        else {
+            while (!q.push(std::move(item))) boost::this_thread::yield();
+            boost::lock_guard<boost::mutex> lock(to_mutex);
+        }
+        to_cond.notify_one();
+        enqueue.push_back(nd_elapsed_ns(start));
+    }
+    done = true;
+    { boost::lock_guard<boost::mutex> lock(to_mutex); }
+    to_cond.notify_one();
+    consumer.join();
+    std::string what(std::string(name) + " at " + std::to_string(rate) + " msgs/s, " + std::to_string(work_us) + "us work/msg,");
+    nd_report_samples("ring", what + " enqueue", enqueue, "ns");
+    nd_report_samples("ring", what + " enqueue to dequeue", latency, "us");
+}
+
+static void bench_ring(std::int64_t n)
+{
+    const int count = n ? static_cast<int>(n) : 50000;
+    for (int work_us : { 0, 50 }) {
+        NDLockedQueue baseline;
+        bench_handoff("baseline", baseline, true, 10000, count, work_us);
+        NDLockedQueue locked;
+        bench_handoff("locked", locked, false, 10000, count, work_us);
+        NDRingBuffer<NDBenchItem> ring;
+        bench_handoff("ring", ring, false, 10000, count, work_us);
+    }
+}
+
+
+// post: py response to cpp thread latency. The py side publishes into an
+// SPSC ring and either posts a handler into the cpp thread's io_service,
+// as NDServer's response callback does, or leaves it for a 16ms timer
+// poll, as on_timeout used to.
+static void bench_post_mode(bool post, int count)
+{
+    boost::asio::io_service io;
+    boost::asio::io_service::work work(io);
+    boost::asio::steady_timer timer(io);
+    NDRingBuffer<nd_clock::time_point> from_python;
+    boost::atomic<bool> posted(false);
+    boost::atomic<bool> done(false);
+    std::vector<std::int64_t> latency;
+    latency.reserve(count);
+    std::function<void()> drain = [&]() {
+        posted = false;
+        nd_clock::time_point stamp;
+        while (from_python.pop(stamp)) latency.push_back(nd_elapsed_us(stamp));
+        if (done && from_python.empty()) io.stop();
+    };
+    std::function<void(const boost::system::error_code&)> tick = [&](const boost::system::error_code& e) {
+        if (e) return;
+        drain();
+        timer.expires_after(std::chrono::milliseconds(16));
+        timer.async_wait(tick);
+    };
+    if (!post) {
+        timer.expires_after(std::chrono::milliseconds(16));
+        timer.async_wait(tick);
+    }
+    boost::thread py([&]() {
+        for (int i = 0; i < count; i++) {
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+            while (!from_python.push(nd_clock::now())) boost::this_thread::yield();
+            if (post && !posted.exchange(true)) io.post(drain);
+        }
+        done = true;
+        io.post(drain);
+    });
+    io.run();
+    py.join();
+    nd_report_samples("post", post ? "io_service::post to handler" : "16ms timer poll", latency, "us");
+}
+
+static void bench_post(std::int64_t n)
+{
+    const int count = n ? static_cast<int>(n) : 2000;
+    bench_post_mode(true, count);
+    bench_post_mode(false, count);
+}
+
+
+// cache: NDCache slots against the nlohmann::json object it replaced, at
+// 100k keys. A frame looks up every bound widget's value; here a frame
+// is 1000 random keys.
+static void bench_cache(std::int64_t n)
+{
+    const std::size_t keys = n ? static_cast<std::size_t>(n) : 100000;
+    const int frames = 1000;
+    const int per_frame = 1000;
+    nlohmann::json obj = nlohmann::json::object();
+    std::vector<std::string> names;
+    char key[32];
+    for (std::size_t i = 0; i < keys; i++) {
+        std::snprintf(key, sizeof(key), "cache_key_%06zu", i);
+        names.push_back(key);
+        obj[names.back()] = static_cast<std::int64_t>(i);
+    }
+    NDCache cache;
+    cache.load(obj);
+    std::mt19937 rng(1729);
+    std::uniform_int_distribution<std::size_t> pick(0, keys - 1);
+    std::vector<std::size_t> lookups;
+    std::vector<NDSlot> slots;
+    for (int i = 0; i < per_frame; i++) {
+        lookups.push_back(pick(rng));
+        slots.push_back(cache.find(names[lookups.back()]));
+    }
+    std::int64_t sum = 0;
+    nd_clock::time_point start(nd_clock::now());
+    for (int f = 0; f < frames; f++) {
+        for (auto i : lookups) sum += obj[names[i]].get<std::int64_t>();
+    }
+    std::int64_t json_ns = nd_elapsed_ns(start);
+    start = nd_clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (auto i : lookups) sum += cache[names[i]].get<std::int64_t>();
+    }
+    std::int64_t string_ns = nd_elapsed_ns(start);
+    start = nd_clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (auto s : slots) sum += cache.get(s).get<std::int64_t>();
+    }
+    std::int64_t slot_ns = nd_elapsed_ns(start);
+    const double n_lookups = double(frames) * per_frame;
+    std::cout << "cache: " << keys << " keys, json object " << json_ns / n_lookups << "ns/lookup, NDCache by key "
+        << string_ns / n_lookups << "ns, by slot " << slot_ns / n_lookups << "ns (checksum " << sum << ")" << std::endl;
+}
+
+
+// inbound: NDInbound under a ticking backend. Each frame admits a burst of
+// DataChanges over a small key set, optionally with a barrier every so
+// many msgs, then dispatches what's staged. Without barriers, per frame
+// dispatch cost should stay flat as the rate grows, since only one
+// DataChange per key survives a frame. Each barrier restarts merging, so
+// with them it grows with the barrier count, up to ND_INBOUND_MAX. admit
+// includes building the msg, as pull_server_responses gets it from py.
+static void bench_inbound_rate(int per_frame, int barrier_every)
+{
+    const int frames = 200;
+    const int key_count = 200;
+    NDInbound inbound;
+    inbound.configure(ND_INBOUND_MAX, ND_OVERFLOW_DROP_OLDEST);
+    std::vector<std::string> keys;
+    for (int k = 0; k < key_count; k++) keys.push_back("px_" + std::to_string(k));
+    nlohmann::json msg;
+    nd_clock::time_point stamp;
+    std::int64_t admit_ns = 0;
+    std::int64_t pop_ns = 0;
+    std::uint64_t seq = 0;
+    for (int f = 0; f < frames; f++) {
+        nd_clock::time_point start(nd_clock::now());
+        for (int i = 0; i < per_frame; i++, seq++) {
+            const std::string& k(keys[seq % key_count]);
+            if (barrier_every && seq % barrier_every == static_cast<std::uint64_t>(barrier_every - 1)) {
+                msg = { {"nd_type", "DataPatch"}, {"cache_key", k}, {"patch", nlohmann::json::array()} };
+                inbound.admit(msg, ND_INBOUND_BARRIER, k, start);
+                continue;
+            }
+            msg = { {"nd_type", "DataChange"}, {"cache_key", k}, {"new_value", static_cast<double>(seq)} };
+            inbound.admit(msg, ND_INBOUND_MERGE, k, start);
+        }
+        admit_ns += nd_elapsed_ns(start);
+        start = nd_clock::now();
+        while (inbound.pop(msg, stamp)) {}
+        pop_ns += nd_elapsed_ns(start);
+    }
+    NDInboundStats s(inbound.get_stats());
+    const double msgs = double(frames) * per_frame;
+    std::cout << "inbound: " << per_frame << " msgs/frame over " << key_count << " keys, barrier every "
+        << barrier_every << ", admit " << admit_ns / msgs
+        << "ns/msg, dispatch " << pop_ns / frames / 1000.0 << "us/frame, merged " << s.merged << ", dispatched "
+        << s.dispatched << " of " << static_cast<std::uint64_t>(msgs) << ", depth max " << s.depth_max
+        << ", dropped " << s.dropped << std::endl;
+}
+
+static void bench_inbound(std::int64_t n)
+{
+    for (int barrier_every : { 0, 1000 }) {
+        if (n) {
+            bench_inbound_rate(static_cast<int>(n), barrier_every);
+            continue;
+        }
+        for (int per_frame : { 100, 1000, 10000, 100000 }) bench_inbound_rate(per_frame, barrier_every);
+    }
+}
+
+
+// A cache snapshot shaped like breadboard's data.json: mostly scalars
+// bound to widgets, some parquet URL lists and small config objects
+static nlohmann::json nd_bench_snapshot(int keys)
+{
+    nlohmann::json cache = nlohmann::json::object();
+    for (int k = 0; k < keys; k++) {
+        const std::string key("key_" + std::to_string(k));
+        switch (k % 5) {
+        case 0: cache[key] = k * 10; break;
+        case 1: cache[key] = 100.0 + k * 0.25; break;
+        case 2: cache[key] = "label " + std::to_string(k); break;
+        case 3: cache[key] = (k % 2) != 0; break;
+        default:
+            if (k % 10 == 4) {
+                nlohmann::json urls = nlohmann::json::array();
+                for (int i = 0; i < 20; i++) {
+                    urls.push_back("s3://breadboard-bench/prices/date=2024-06-03/part-" + std::to_string(i) + ".parquet");
+                }
+                cache[key] = urls;
+            }
+            else {
+                cache[key] = { {"query_id", key}, {"rows", k}, {"filter", "venue = 'XLON'"}, {"live", true} };
+            }
+        }
+    }
+    return cache;
+}
+
+
+// codec: bytes and encode/decode time per wire encoding, for a QueryResult
+// and for a DataChange carrying a cache snapshot
+static void bench_codec_msg(const char* what, const char* field, const nlohmann::json& msg)
+{
+    const int reps = 20;
+    const std::size_t entries = msg[field].size();
+    std::string buf;
+    for (int e = ND_ENC_JSON; e <= ND_ENC_CBOR; e++) {
+        NDEncoding enc = static_cast<NDEncoding>(e);
+        nd_clock::time_point start(nd_clock::now());
+        for (int r = 0; r < reps; r++) nd_encode(msg, enc, buf);
+        std::int64_t encode_us = nd_elapsed_us(start) / reps;
+        std::size_t count = 0;
+        start = nd_clock::now();
+        for (int r = 0; r < reps; r++) count += nd_decode(buf.data(), buf.size(), enc)[field].size();
+        std::int64_t decode_us = nd_elapsed_us(start) / reps;
+        std::cout << "codec: " << what << " " << nd_encoding_names[e] << " " << buf.size() << " bytes, encode "
+            << encode_us << "us, decode " << decode_us << "us, "
+            << (decode_us ? buf.size() / double(decode_us) : 0.0) << " MB/s decode" << std::endl;
+        if (count != entries * reps) std::cerr << "codec: " << what << " " << nd_encoding_names[e] << " round trip lost entries" << std::endl;
+    }
+}
+
+static void bench_codec(std::int64_t n)
+{
+    const std::int64_t rows = n ? n : 10000;
+    const int keys = 1000;
+    bench_codec_msg((std::to_string(rows) + " row result").c_str(), "rows",
+        { {"nd_type", "QueryResult"}, {"query_id", "bench"}, {"rows", nd_bench_rows(rows)} });
+    bench_codec_msg((std::to_string(keys) + " key snapshot").c_str(), "new_value",
+        { {"nd_type", "DataChange"}, {"cache_key", "snapshot"}, {"new_value", nd_bench_snapshot(keys)} });
+}
+
+
+// patch: one element changed in a long list of parquet URLs, sent as a
+// DataPatch rather than the whole value
+static void bench_patch(std::int64_t n)
+{
+    const int elements = n ? static_cast<int>(n) : 10000;
+    nlohmann::json old_val = nlohmann::json::array();
+    for (int i = 0; i < elements; i++) {
+        old_val.push_back("s3://breadboard-bench/prices/date=2024-06-03/part-" + std::to_string(i) + ".parquet");
+    }
+    nlohmann::json new_val(old_val);
+    new_val[elements / 2] = "s3://breadboard-bench/prices/date=2024-06-04/part-0.parquet";
+    nd_clock::time_point start(nd_clock::now());
+    nlohmann::json patch = nlohmann::json::diff(old_val, new_val);
+    std::int64_t diff_us = nd_elapsed_us(start);
+    std::size_t patch_bytes = patch.dump().size();
+    std::size_t full_bytes = new_val.dump().size();
+
+    NDCache cache;
+    NDSlot s = cache.slot("urls");
+    cache.set(s, old_val);
+    start = nd_clock::now();
+    cache.patch(s, patch);
+    std::int64_t inplace_us = nd_elapsed_us(start);
+    // two ops go through the all or nothing copy
+    nlohmann::json two_ops = { patch[0], { {"op", "test"}, {"path", patch[0]["path"]}, {"value", patch[0]["value"]} } };
+    start = nd_clock::now();
+    cache.patch(s, two_ops);
+    std::int64_t copy_us = nd_elapsed_us(start);
+    start = nd_clock::now();
+    cache.set(s, new_val);
+    std::int64_t set_us = nd_elapsed_us(start);
+    std::cout << "patch: " << elements << " elements, patch " << patch_bytes << " bytes vs " << full_bytes
+        << ", diff " << diff_us << "us, apply in place " << inplace_us << "us, apply to copy " << copy_us
+        << "us, set full value " << set_us << "us" << std::endl;
+}
+
+
+#ifdef ND_BENCH_ZLIB
+// deflate: zlib with permessage-deflate's parameters, a raw stream with
+// the trailing empty block stripped, per msg size. Shows where
+// ND_WS_DEFLATE_MIN_BYTES sits: below it deflate costs more latency than
+// the bytes it saves.
+static void bench_deflate(std::int64_t n)
+{
+    const int reps = 50;
+    std::string text = nlohmann::json({ {"nd_type", "QueryResult"}, {"rows", nd_bench_rows(n ? n : 20000)} }).dump();
+    std::string out;
+    std::string back;
+    z_stream dz = {};
+    z_stream iz = {};
+    deflateInit2(&dz, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    inflateInit2(&iz, -15);
+    for (std::size_t size : { std::size_t(64), std::size_t(256), std::size_t(1024), std::size_t(4096),
+                                std::size_t(65536), std::size_t(1 << 20) }) {
+        if (size > text.size()) continue;
+        const std::string msg(text.substr(0, size));
+        std::int64_t deflate_ns = 0;
+        std::int64_t inflate_ns = 0;
+        for (int r = 0; r < reps; r++) {
+            nd_clock::time_point start(nd_clock::now());
+            deflateReset(&dz);
+            out.resize(deflateBound(&dz, static_cast<uLong>(msg.size())) + 16);
+            dz.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(msg.data()));
+            dz.avail_in = static_cast<uInt>(msg.size());
+            dz.next_out = reinterpret_cast<Bytef*>(&out[0]);
+            dz.avail_out = static_cast<uInt>(out.size());
+            deflate(&dz, Z_SYNC_FLUSH);
+            out.resize(out.size() - dz.avail_out - 4);
+            deflate_ns += nd_elapsed_ns(start);
+
+            start = nd_clock::now();
+            inflateReset(&iz);
+            out.append("\x00\x00\xff\xff", 4);
+            back.resize(msg.size());
+            iz.next_in = reinterpret_cast<Bytef*>(&out[0]);
+            iz.avail_in = static_cast<uInt>(out.size());
+            iz.next_out = reinterpret_cast<Bytef*>(&back[0]);
+            iz.avail_out = static_cast<uInt>(back.size());
+            inflate(&iz, Z_SYNC_FLUSH);
+            inflate_ns += nd_elapsed_ns(start);
+            out.resize(out.size() - 4);
+        }
+        if (back != msg) std::cerr << "deflate: round trip mismatch at " << msg.size() << " bytes" << std::endl;
+        std::cout << "deflate: " << msg.size() << " bytes -> " << out.size() << " ("
+            << 100.0 * out.size() / msg.size() << "%), deflate " << deflate_ns / reps / 1000.0 << "us, inflate "
+            << inflate_ns / reps / 1000.0 << "us" << std::endl;
+    }
+    deflateEnd(&dz);
+    inflateEnd(&iz);
+}
+#endif
+
+
+#ifdef ND_BENCH_ARROW
+static std::shared_ptr<arrow::Schema> nd_bench_schema()
+{
+    return arrow::schema({
+        arrow::field("id", arrow::int64()), arrow::field("ticker", arrow::utf8()),
+        arrow::field("px", arrow::float64()), arrow::field("qty", arrow::int64()),
+        arrow::field("side", arrow::utf8()), arrow::field("venue", arrow::utf8()),
+        arrow::field("ts", arrow::timestamp(arrow::TimeUnit::MICRO, "UTC")),
+        arrow::field("bid", arrow::float64()), arrow::field("ask", arrow::float64()),
+        arrow::field("live", arrow::boolean()) });
+}
+
+// the nd_bench_row values, as arrow columns
+static arrow::Result<std::shared_ptr<arrow::RecordBatch>> nd_bench_batch(std::int64_t first, std::int64_t rows)
+{
+    static const char* sides[] = { "BUY", "SELL" };
+    static const char* venues[] = { "XLON", "XPAR", "XETR", "XAMS" };
+    arrow::Int64Builder id, qty;
+    arrow::StringBuilder ticker, side, venue;
+    arrow::DoubleBuilder px, bid, ask;
+    arrow::TimestampBuilder ts(arrow::timestamp(arrow::TimeUnit::MICRO, "UTC"), arrow::default_memory_pool());
+    arrow::BooleanBuilder live;
+    char buf[16];
+    for (std::int64_t i = first; i < first + rows; i++) {
+        std::snprintf(buf, sizeof(buf), "T%05lld", static_cast<long long>(i % 50000));
+        double p = 100.0 + (i % 1000) * 0.01;
+        ARROW_RETURN_NOT_OK(id.Append(i));
+        ARROW_RETURN_NOT_OK(ticker.Append(buf));
+        ARROW_RETURN_NOT_OK(px.Append(p));
+        ARROW_RETURN_NOT_OK(qty.Append((i % 97) * 100));
+        ARROW_RETURN_NOT_OK(side.Append(sides[i % 2]));
+        ARROW_RETURN_NOT_OK(venue.Append(venues[i % 4]));
+        ARROW_RETURN_NOT_OK(ts.Append(1717401600000000LL));
+        ARROW_RETURN_NOT_OK(bid.Append(p - 0.01));
+        ARROW_RETURN_NOT_OK(ask.Append(p + 0.01));
+        ARROW_RETURN_NOT_OK(live.Append((i % 3) != 0));
+    }
+    std::vector<std::shared_ptr<arrow::Array>> columns(10);
+    ARROW_RETURN_NOT_OK(id.Finish(&columns[0]));
+    ARROW_RETURN_NOT_OK(ticker.Finish(&columns[1]));
+    ARROW_RETURN_NOT_OK(px.Finish(&columns[2]));
+    ARROW_RETURN_NOT_OK(qty.Finish(&columns[3]));
+    ARROW_RETURN_NOT_OK(side.Finish(&columns[4]));
+    ARROW_RETURN_NOT_OK(venue.Finish(&columns[5]));
+    ARROW_RETURN_NOT_OK(ts.Finish(&columns[6]));
+    ARROW_RETURN_NOT_OK(bid.Finish(&columns[7]));
+    ARROW_RETURN_NOT_OK(ask.Finish(&columns[8]));
+    ARROW_RETURN_NOT_OK(live.Finish(&columns[9]));
+    return arrow::RecordBatch::Make(nd_bench_schema(), rows, columns);
+}
+
+// an NDAR frame, as nd_ipc.hpp lays it out, holding rows in 64k row batches
+static arrow::Result<std::string> nd_bench_ipc_frame(const std::string& qid, std::int64_t rows, bool last)
+{
+    ARROW_ASSIGN_OR_RAISE(auto sink, arrow::io::BufferOutputStream::Create());
+    ARROW_ASSIGN_OR_RAISE(auto writer, arrow::ipc::MakeStreamWriter(sink, nd_bench_schema()));
+    for (std::int64_t first = 0; first < rows; first += 65536) {
+        ARROW_ASSIGN_OR_RAISE(auto batch, nd_bench_batch(first, std::min<std::int64_t>(65536, rows - first)));
+        ARROW_RETURN_NOT_OK(writer->WriteRecordBatch(*batch));
+    }
+    ARROW_RETURN_NOT_OK(writer->Close());
+    ARROW_ASSIGN_OR_RAISE(auto body, sink->Finish());
+    std::string frame(ND_IPC_MAGIC, ND_IPC_MAGIC_SZ);
+    frame += static_cast<char>(ND_IPC_VERSION);
+    frame += static_cast<char>(last ? ND_IPC_LAST : 0);
+    frame += static_cast<char>(qid.size() & 0xFF);
+    frame += static_cast<char>(qid.size() >> 8);
+    frame += qid;
+    frame.append(((qid.size() + 7) & ~std::size_t(7)) - qid.size(), '\0');
+    frame.append(reinterpret_cast<const char*>(body->data()), static_cast<std::size_t>(body->size()));
+    return frame;
+}
+
+// ipc: decode a 1M row, 10 column result from an NDAR frame, and the same
+// rows as JSON text
+static void bench_ipc(std::int64_t n)
+{
+    const std::int64_t rows = n ? n : 1000000;
+    auto frame = nd_bench_ipc_frame("bench", rows, true);
+    if (!frame.ok()) {
+        std::cerr << "ipc: " << frame.status().ToString() << std::endl;
+        return;
+    }
+    // frames arrive in a websocketpp msg payload; a std::string stands in
+    auto payload = std::make_shared<std::string>(std::move(*frame));
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+    nd_clock::time_point start(nd_clock::now());
+    NDIPCFrame hdr;
+    arrow::Status status;
+    if (!nd_ipc_frame(payload->data(), payload->size(), hdr)) {
+        std::cerr << "ipc: bad frame header" << std::endl;
+        return;
+    }
+    status = nd_ipc_read(payload->data(), payload->size(), hdr, payload, batches);
+    std::int64_t ipc_us = nd_elapsed_us(start);
+    std::int64_t ipc_rows = 0;
+    for (auto& b : batches) ipc_rows += b->num_rows();
+    if (!status.ok()) std::cerr << "ipc: " << status.ToString() << std::endl;
+
+    std::string text = nlohmann::json({ {"nd_type", "QueryResult"}, {"query_id", "bench"}, {"rows", nd_bench_rows(rows)} }).dump();
+    start = nd_clock::now();
+    std::size_t json_rows = nlohmann::json::parse(text)["rows"].size();
+    std::int64_t json_us = nd_elapsed_us(start);
+    std::cout << "ipc: " << ipc_rows << " rows, NDAR " << payload->size() << " bytes, decode " << ipc_us << "us; JSON "
+        << json_rows << " rows, " << text.size() << " bytes, parse " << json_us << "us" << std::endl;
+}
+#endif
+
+
+#ifdef ND_BENCH_WS
+// A websocketpp server standing in for the breadboard backend, with the
+// same NDDeflate extension as the client, but its own stats.
+struct nd_bench_server_config : public websocketpp::config::asio {
+    typedef nd_bench_server_config type;
+    typedef websocketpp::config::asio base;
+
+    typedef base::concurrency_type concurrency_type;
+    typedef base::request_type request_type;
+    typedef base::response_type response_type;
+    typedef base::message_type message_type;
+    typedef base::con_msg_manager_type con_msg_manager_type;
+    typedef base::endpoint_msg_manager_type endpoint_msg_manager_type;
+    typedef base::alog_type alog_type;
+    typedef base::elog_type elog_type;
+    typedef base::rng_type rng_type;
+
+    struct transport_config : public base::transport_config {
+        typedef type::concurrency_type concurrency_type;
+        typedef type::alog_type alog_type;
+        typedef type::elog_type elog_type;
+        typedef type::request_type request_type;
+        typedef type::response_type response_type;
+        typedef websocketpp::transport::asio::basic_socket::endpoint socket_type;
+    };
+    typedef websocketpp::transport::asio::endpoint<transport_config> transport_type;
+
+    struct permessage_deflate_config {};
+    typedef NDDeflate<permessage_deflate_config> permessage_deflate_type;
+};
+
+typedef websocketpp::server<nd_bench_server_config> nd_bench_server;
+typedef websocketpp::client<nd_ws_config> nd_bench_client;
+typedef websocketpp::connection_hdl ws_handle;
+typedef websocketpp::lib::error_code ws_error_code;
+
+#define ND_BENCH_PORT       8892
+#define ND_BENCH_MAX_MSG    (256 << 20)
+
+using websocketpp::lib::placeholders::_1;
+using websocketpp::lib::placeholders::_2;
+using websocketpp::lib::bind;
+
+// Answers the msgs breadboard sends: ParquetScan with a ParquetScanResult,
+// Query with a 100k row NDAR frame, or without arrow an error. Bench
+// msgs: Echo comes straight back, Stream sends a result of the requested
+// size as one JSON msg. drop_ms closes every connection that often, and
+// nopong swallows pings, to exercise NDWebSockClient's reconnect and pong
+// timeout paths. A client offering nd.msgpack or nd.cbor gets it, and
+// replies go out in the encoding of the request.
+class NDBenchServer {
+public:
+    NDBenchServer(int p, long drop, bool pong) : port(p), drop_ms(drop), answer_pings(pong) {
+        server.clear_access_channels(websocketpp::log::alevel::all);
+        server.clear_error_channels(websocketpp::log::elevel::all);
+        server.init_asio(&io);
+        server.set_reuse_addr(true);
+        server.set_validate_handler(bind(&NDBenchServer::on_validate, this, ::_1));
+        server.set_open_handler(bind(&NDBenchServer::on_open, this, ::_1));
+        server.set_close_handler(bind(&NDBenchServer::on_close, this, ::_1));
+        server.set_message_handler(bind(&NDBenchServer::on_message, this, ::_1, ::_2));
+        server.set_ping_handler(bind(&NDBenchServer::on_ping, this, ::_1, ::_2));
+    }
+
+    void start() {
+        server.listen(port);
+        server.start_accept();
+        if (drop_ms) schedule_drop();
+        thread = boost::thread([this]() { io.run(); });
+    }
+
+    void stop() {
+        io.post([this]() {
+            ws_error_code ec;
+            server.stop_listening(ec);
+            for (auto& h : connections) server.close(h, websocketpp::close::status::going_away, "stop", ec);
+            if (drop_timer) drop_timer->cancel();
+        });
+        thread.join();
+    }
+
+    void join() { thread.join(); }
+
+private:
+    // take the first subprotocol we speak from the client's offers
+    bool on_validate(ws_handle h) {
+        nd_bench_server::connection_ptr con = server.get_con_from_hdl(h);
+        for (auto& sp : con->get_requested_subprotocols()) {
+            if (nd_encoding(sp) != ND_ENC_JSON) {
+                con->select_subprotocol(sp);
+                break;
+            }
+        }
+        return true;
+    }
+
+    void on_open(ws_handle h) { connections.insert(h); }
+    void on_close(ws_handle h) { connections.erase(h); }
+    bool on_ping(ws_handle h, std::string payload) { return answer_pings; }
+
+    void on_message(ws_handle h, nd_bench_server::message_ptr msg) {
+        nd_bench_server::connection_ptr con = server.get_con_from_hdl(h);
+        NDEncoding enc = msg->get_opcode() == websocketpp::frame::opcode::BINARY ?
+                            nd_encoding(con->get_subprotocol()) : ND_ENC_JSON;
+        nlohmann::json req;
+        try {
+            req = nd_decode(msg->get_payload().data(), msg->get_payload().size(), enc);
+        }
+        catch (nlohmann::json::exception& ex) {
+            std::cerr << "NDBenchServer::on_message: " << ex.what() << std::endl;
+            return;
+        }
+        const std::string nd_type(req.value("nd_type", ""));
+        if (nd_type == "Echo") {
+            send(h, msg->get_payload(), msg->get_opcode(), msg->get_compressed());
+        }
+        else if (nd_type == "Stream") {
+            std::int64_t bytes = req.value("bytes", 1 << 20);
+            // ~100 bytes a row as JSON text
+            nlohmann::json result = { {"nd_type", "QueryResult"}, {"query_id", "stream"}, {"rows", nd_bench_rows(bytes / 100)} };
+            send(h, result.dump(), websocketpp::frame::opcode::TEXT, req.value("compress", false));
+        }
+        else if (nd_type == "ParquetScan") {
+            reply(h, enc, { {"nd_type", "ParquetScanResult"}, {"query_id", req.value("query_id", "")} });
+        }
+        else if (nd_type == "Query") {
+#ifdef ND_BENCH_ARROW
+            auto frame = nd_bench_ipc_frame(req.value("query_id", ""), 100000, true);
+            if (frame.ok()) {
+                send(h, *frame, websocketpp::frame::opcode::BINARY, true);
+                return;
+            }
+#endif
+            reply(h, enc, { {"nd_type", "QueryResultEnd"}, {"query_id", req.value("query_id", "")},
+                            {"rows", 0}, {"batches", 0}, {"error", "nd_bench built without arrow"} });
+        }
+    }
+
+    // answer in the encoding the request came in
+    void reply(ws_handle h, NDEncoding enc, const nlohmann::json& resp) {
+        nd_encode(resp, enc, send_buf);
+        send(h, send_buf, nd_binary_encoding(enc) ? websocketpp::frame::opcode::BINARY : websocketpp::frame::opcode::TEXT,
+            send_buf.size() >= ND_WS_DEFLATE_MIN_BYTES);
+    }
+
+    void send(ws_handle h, const std::string& payload, websocketpp::frame::opcode::value op, bool compress) {
+        ws_error_code ec;
+        nd_bench_server::message_ptr msg = websocketpp::lib::make_shared<nd_bench_server_config::message_type>(
+            nd_bench_server_config::con_msg_manager_type::ptr(), op, payload.size());
+        msg->append_payload(payload);
+        msg->set_compressed(compress);
+        server.send(h, msg, ec);
+        if (ec) std::cerr << "NDBenchServer::send: " << ec.message() << std::endl;
+    }
+
+    void schedule_drop() {
+        if (!drop_timer) drop_timer.reset(new boost::asio::steady_timer(io));
+        drop_timer->expires_after(std::chrono::milliseconds(drop_ms));
+        drop_timer->async_wait([this](const boost::system::error_code& e) {
+            if (e) return;
+            ws_error_code ec;
+            std::cout << "NDBenchServer: dropping " << connections.size() << " connections" << std::endl;
+            for (auto& h : connections) server.close(h, websocketpp::close::status::service_restart, "drop", ec);
+            schedule_drop();
+        });
+    }
+
+    int                     port;
+    long                    drop_ms;
+    bool                    answer_pings;
+    boost::asio::io_service io;
+    nd_bench_server         server;
+    boost::thread           thread;
+    std::string             send_buf;
+    std::unique_ptr<boost::asio::steady_timer>          drop_timer;
+    std::set<ws_handle, std::owner_less<ws_handle>>     connections;
+};
+
+// A bare client on nd_ws_config, driven by the caller: run_until polls
+// its io_service on the calling thread, so a bench can interleave it with
+// a frame loop, or run it on a thread of its own.
+class NDBenchClient {
+public:
+    explicit NDBenchClient(bool deflate) {
+        nd_ws_deflate::offer_enabled() = deflate;
+        client.clear_access_channels(websocketpp::log::alevel::all);
+        client.clear_error_channels(websocketpp::log::elevel::all);
+        client.init_asio(&io);
+        // websocketpp's 32MB default would refuse the jitter bench's result
+        client.set_max_message_size(ND_BENCH_MAX_MSG);
+        client.set_open_handler([this](ws_handle h) { handle = h; open = true; });
+        client.set_fail_handler([this](ws_handle h) { failed = true; });
+        client.set_message_handler([this](ws_handle h, nd_bench_client::message_ptr msg) {
+            received++;
+            bytes_in += msg->get_payload().size();
+            if (on_msg) on_msg(msg);
+        });
+    }
+
+    bool connect(int port) {
+        ws_error_code ec;
+        nd_bench_client::connection_ptr con = client.get_connection("ws://localhost:" + std::to_string(port) + "/api/websock", ec);
+        if (ec) {
+            std::cerr << "NDBenchClient::connect: " << ec.message() << std::endl;
+            return false;
+        }
+        client.connect(con);
+        run_until([this]() { return open || failed; });
+        return open;
+    }
+
+    void send(const std::string& payload, bool compress) {
+        ws_error_code ec;
+        nd_bench_client::message_ptr msg = websocketpp::lib::make_shared<nd_ws_config::message_type>(
+            nd_ws_config::con_msg_manager_type::ptr(), websocketpp::frame::opcode::TEXT, payload.size());
+        msg->append_payload(payload);
+        msg->set_compressed(compress);
+        client.send(handle, msg, ec);
+        if (ec) std::cerr << "NDBenchClient::send: " << ec.message() << std::endl;
+    }
+
+    template <typename Pred>
+    void run_until(Pred done) {
+        while (!done() && !io.stopped()) io.run_one();
+    }
+
+    void close() {
+        ws_error_code ec;
+        client.close(handle, websocketpp::close::status::normal, "done", ec);
+        run_until([this]() { return client.get_con_from_hdl(handle)->get_state() == websocketpp::session::state::closed; });
+    }
+
+    boost::asio::io_service     io;
+    nd_bench_client             client;
+    ws_handle                   handle;
+    bool                        open = false;
+    bool                        failed = false;
+    std::uint64_t               received = 0;
+    std::uint64_t               bytes_in = 0;
+    std::function<void(nd_bench_client::message_ptr)> on_msg;
+};
+
+static void bench_ws_mode(bool deflate)
+{
+    NDBenchServer server(ND_BENCH_PORT, 0, true);
+    server.start();
+    NDBenchClient client(deflate);
+    if (!client.connect(ND_BENCH_PORT)) {
+        std::cerr << "ws: no connection" << std::endl;
+        server.stop();
+        return;
+    }
+    const char* mode = deflate ? "deflate" : "plain";
+    nd_ws_deflate::stats() = NDDeflateStats();
+    // small msgs go uncompressed either way: ws_deflate_min_bytes
+    std::string small = nlohmann::json({ {"nd_type", "Echo"}, {"cache_key", "px"}, {"new_value", 101.25} }).dump();
+    std::string large = nlohmann::json({ {"nd_type", "Echo"}, {"rows", nd_bench_rows(2000)} }).dump();
+    std::vector<std::int64_t> rtt;
+    for (auto* payload : { &small, &large }) {
+        rtt.clear();
+        const int reps = payload == &small ? 2000 : 200;
+        for (int i = 0; i < reps; i++) {
+            std::uint64_t expect = client.received + 1;
+            nd_clock::time_point start(nd_clock::now());
+            client.send(*payload, deflate && payload->size() >= ND_WS_DEFLATE_MIN_BYTES);
+            client.run_until([&]() { return client.received >= expect; });
+            rtt.push_back(nd_elapsed_us(start));
+        }
+        nd_report_samples("ws", std::string(mode) + " echo rtt " + std::to_string(payload->size()) + " bytes", rtt, "us");
+    }
+    // server to client throughput on a 10MB result
+    std::uint64_t expect = client.received + 1;
+    std::uint64_t before = client.bytes_in;
+    nd_clock::time_point start(nd_clock::now());
+    client.send(nlohmann::json({ {"nd_type", "Stream"}, {"bytes", 10 << 20}, {"compress", deflate} }).dump(), false);
+    client.run_until([&]() { return client.received >= expect; });
+    std::int64_t stream_us = nd_elapsed_us(start);
+    const NDDeflateStats& ds(nd_ws_deflate::stats());
+    std::cout << "ws: " << mode << " 10MB result in " << stream_us << "us, " << (client.bytes_in - before)
+        << " bytes, client inflate " << ds.in_wire << " -> " << ds.in_raw << " bytes in " << ds.inflate_us
+        << "us, deflate " << ds.out_raw << " -> " << ds.out_wire << " bytes in " << ds.deflate_us << "us" << std::endl;
+    client.close();
+    server.stop();
+}
+
+static void bench_ws(std::int64_t)
+{
+    bench_ws_mode(false);
+    bench_ws_mode(true);
+}
+// jitter: frame pacing at 60fps while a big QueryResult arrives. inline
+// parses on the render thread, polling websock I/O between frames, as
+// NDWebSockClient used to; threaded parses on an I/O thread into an SPSC
+// ring that the frame loop drains within ws_drain_budget_us.
+static void bench_jitter_mode(bool threaded, std::int64_t mb)
+{
+    NDBenchServer server(ND_BENCH_PORT, 0, true);
+    server.start();
+    NDBenchClient client(false);
+    if (!client.connect(ND_BENCH_PORT)) {
+        std::cerr << "jitter: no connection" << std::endl;
+        server.stop();
+        return;
+    }
+    NDRingBuffer<nlohmann::json> inbound;
+    boost::atomic<std::uint64_t> parsed(0);
+    std::size_t rows = 0;
+    client.on_msg = [&](nd_bench_client::message_ptr msg) {
+        nlohmann::json j = nlohmann::json::parse(msg->get_payload());
+        parsed++;
+        while (!inbound.push(std::move(j))) boost::this_thread::yield();
+    };
+    client.send(nlohmann::json({ {"nd_type", "Stream"}, {"bytes", mb << 20} }).dump(), false);
+    boost::thread io_thread;
+    boost::atomic<bool> stop(false);
+    if (threaded) {
+        io_thread = boost::thread([&]() { client.run_until([&]() { return stop.load(); }); });
+    }
+    const nd_clock::duration period(std::chrono::microseconds(16667));
+    const std::chrono::microseconds budget(4000);
+    std::vector<std::int64_t> intervals;
+    nd_clock::time_point next(nd_clock::now());
+    nd_clock::time_point last(next);
+    nlohmann::json msg;
+    // a few frames past the result landing, so the tail is measured
+    int frames_after = 30;
+    while (frames_after > 0) {
+        nd_clock::time_point start(nd_clock::now());
+        intervals.push_back(std::chrono::duration_cast<std::chrono::microseconds>(start - last).count());
+        last = start;
+        if (!threaded) client.io.poll();
+        nd_clock::time_point deadline(nd_clock::now() + budget);
+        while (inbound.pop(msg)) {
+            rows += msg["rows"].size();
+            if (nd_clock::now() >= deadline) break;
+        }
+        // stand in for 2ms of render
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(2));
+        if (parsed && inbound.empty()) frames_after--;
+        next += period;
+        boost::this_thread::sleep_until(boost::chrono::steady_clock::now()
+            + boost::chrono::microseconds(std::max<std::int64_t>(0,
+                std::chrono::duration_cast<std::chrono::microseconds>(next - nd_clock::now()).count())));
+    }
+    if (threaded) {
+        stop = true;
+        client.io.post([]() {});
+        io_thread.join();
+    }
+    client.close();
+    server.stop();
+    std::int64_t late = std::count_if(intervals.begin(), intervals.end(), [](std::int64_t us) { return us > 33333; });
+    nd_report_samples("jitter", std::string(threaded ? "threaded" : "inline") + " " + std::to_string(mb)
+        + "MB result, frame interval", intervals, "us");
+    std::cout << "jitter: " << (threaded ? "threaded" : "inline") << " " << rows << " rows, " << late
+        << " frames over 2 periods" << std::endl;
+}
+
+static void bench_jitter(std::int64_t n)
+{
+    const std::int64_t mb = n ? n : 50;
+    bench_jitter_mode(false, mb);
+    bench_jitter_mode(true, mb);
+}
+#endif
+
+
+// layout: not a bench itself, but writes layout.json and data.json into
+// the current dir for breadboard's headless "frames" bench: a Home window
+// of InputInts, Texts and Buttons, with SameLines and Separators between.
+// breadboard still imports the test dir's name as its py module.
+static bool nd_write_json(const char* path, const nlohmann::json& j)
+{
+    std::ofstream out(path);
+    out << j.dump(1) << std::endl;
+    if (!out) {
+        std::cerr << "layout: can't write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void bench_layout(std::int64_t n)
+{
+    const std::int64_t widgets = n ? n : 5000;
+    nlohmann::json children(nlohmann::json::array());
+    nlohmann::json data(nlohmann::json::object());
+    for (std::int64_t i = 0; i < widgets; i++) {
+        const std::string k(std::to_string(i));
+        nlohmann::json widget;
+        switch (i % 5) {
+        case 0:
+            widget = { {"rname", "InputInt"}, {"cspec", { {"cname", "int" + k}, {"label", "int" + k} }} };
+            data["int" + k] = i;
+            break;
+        case 1:
+            widget = { {"rname", "SameLine"} };
+            break;
+        case 2:
+            widget = { {"rname", "Text"}, {"cspec", { {"text", "text" + k} }} };
+            break;
+        case 3:
+            widget = { {"rname", "Button"}, {"cspec", { {"text", "button" + k} }} };
+            break;
+        default:
+            widget = { {"rname", "Separator"} };
+            break;
+        }
+        children.push_back(widget);
+    }
+    nlohmann::json home = { {"rname", "Home"}, {"cspec", { {"title", "nd_bench layout"} }}, {"children", children} };
+    nlohmann::json layout(nlohmann::json::array());
+    layout.push_back(home);
+    if (nd_write_json("layout.json", layout) && nd_write_json("data.json", data)) {
+        std::cout << "layout: " << widgets << " widgets in layout.json, " << data.size() << " keys in data.json" << std::endl;
+    }
+}
+
+// table_layout: as layout, but Home holds one sortable, filterable Table
+// on headless_table_result, for the headless "table_rows" bench
+static void bench_table_layout(std::int64_t)
+{
+    nlohmann::json table = { {"rname", "Table"}, {"cspec", { {"cname", "headless_table_result"}, {"filter", true} }} };
+    nlohmann::json home = { {"rname", "Home"}, {"cspec", { {"title", "nd_bench table_layout"} }},
+                            {"children", nlohmann::json::array({ table })} };
+    nlohmann::json layout(nlohmann::json::array());
+    layout.push_back(home);
+    nlohmann::json data = { {"headless_table_result", nullptr} };
+    if (nd_write_json("layout.json", layout) && nd_write_json("data.json", data)) {
+        std::cout << "table_layout: Table on headless_table_result in layout.json" << std::endl;
+    }
+}
+
+
+typedef void (*nd_bench_fn)(std::int64_t n);
+
+struct NDBench {
+    const char*     name;
+    nd_bench_fn     run;
+    bool            by_default;     // run when no benches are named
+};
+
+static NDBench nd_benches[] = {
+    { "ring", bench_ring, true },
+    { "post", bench_post, true },
+    { "cache", bench_cache, true },
+    { "inbound", bench_inbound, true },
+    { "codec", bench_codec, true },
+    { "patch", bench_patch, true },
+#ifdef ND_BENCH_ZLIB
+    { "deflate", bench_deflate, true },
+#endif
+#ifdef ND_BENCH_ARROW
+    { "ipc", bench_ipc, true },
+#endif
+#ifdef ND_BENCH_WS
+    { "ws", bench_ws, true },
+    { "jitter", bench_jitter, false },
+#endif
+    { "layout", bench_layout, false },
+    { "table_layout", bench_table_layout, false },
+};
+
+
+int main(int argc, char** argv)
+{
+#ifdef ND_BENCH_WS
+    if (argc > 1 && std::strcmp(argv[1], "serve") == 0) {
+        int port = argc > 2 ? std::atoi(argv[2]) : ND_BENCH_PORT;
+        long drop_ms = argc > 3 ? std::atol(argv[3]) : 0;
+        bool pong = !(argc > 4 && std::strcmp(argv[4], "nopong") == 0);
+        std::cout << "nd_bench: serving on " << port << ", drop_ms " << drop_ms << (pong ? "" : ", no pongs") << std::endl;
+        NDBenchServer server(port, drop_ms, pong);
+        server.start();
+        server.join();
+        return 0;
+    }
+#endif
+    if (argc == 1) {
+        for (auto& b : nd_benches) {
+            if (b.by_default) b.run(0);
+        }
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        NDBench* bench = nullptr;
+        for (auto& b : nd_benches) {
+            if (std::strcmp(argv[i], b.name) == 0) bench = &b;
+        }
+        if (!bench) {
+            std::cerr << "nd_bench: unknown bench " << argv[i] << std::endl;
+            return 1;
+        }
+        // an optional count follows the name
+        std::int64_t n = 0;
+        if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+            n = std::atoll(argv[++i]);
+        }
+        bench->run(n);
+    }
+    return 0;
+}
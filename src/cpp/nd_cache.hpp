@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "json.hpp"
+
+// NDContext data cache. This used to be a plain nlohmann::json object, so
+// every data[cname] in a render func was a std::map<std::string, json>
+// lookup with string compares, several per widget per frame. Worse, a
+// missing key silently inserted a null. Here keys are interned once into
+// dense integer slots, and values live in a contiguous vector indexed by
+// slot. The layout compiler resolves each widget's cname to a slot, so
+// render funcs index an array. String keyed access is still here for
+// dispatch_server_responses, action_dispatch and the Python side. Each
+// slot carries a version bumped on every set so widgets can cheaply
+// detect a changed value and rebuild anything derived from it.
+// NB get() refs are invalidated when a new key is interned.
+
+typedef std::uint32_t NDSlot;
+
+#define ND_NO_SLOT 0xFFFFFFFF
+
+class NDCache {
+public:
+    // load the top level of the "data" JSON object, one slot per key
+    void load(const nlohmann::json& obj) {
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            set(slot(it.key()), it.value());
+        }
+    }
+
+    // intern key: existing slot, or a new one holding null
+    NDSlot slot(const std::string& key) {
+        auto it = index.find(key);
+        if (it != index.end()) return it->second;
+        NDSlot s = static_cast<NDSlot>(values.size());
+        auto ins = index.emplace(key, s);
+        keys.push_back(&ins.first->first);
+        values.emplace_back();
+        versions.push_back(0);
+        return s;
+    }
+
+    // lookup without interning: ND_NO_SLOT for unknown keys
+    NDSlot find(const std::string& key) const {
+        auto it = index.find(key);
+        return it == index.end() ? ND_NO_SLOT : it->second;
+    }
+    bool contains(const std::string& key) const {
+        NDSlot s = find(key);
+        return s != ND_NO_SLOT && !values[s].is_null();
+    }
+
+    nlohmann::json& get(NDSlot s) { return values[s]; }
+    const nlohmann::json& get(NDSlot s) const { return values[s]; }
+    std::uint64_t version(NDSlot s) const { return versions[s]; }
+    const std::string& key(NDSlot s) const { return *keys[s]; }
+
+    void set(NDSlot s, const nlohmann::json& v) {
+        values[s] = v;
+        versions[s]++;
+    }
+    void set(NDSlot s, nlohmann::json&& v) {
+        values[s] = std::move(v);
+        versions[s]++;
+    }
+    // RFC 6902 patch, all or nothing: throws nlohmann::json::exception on
+    // a bad op, leaving the value and version as they were. A single op
+    // other than move fails before it changes anything, so it's applied
+    // in place: no copy of a large value to change one element. Anything
+    // else is applied to a copy that replaces the value on success.
+    void patch(NDSlot s, const nlohmann::json& p) {
+        if (p.size() == 1 && p[0].value("op", "") != "move") {
+            values[s].patch_inplace(p);
+        }
+        else {
+            nlohmann::json v(values[s]);
+            v.patch_inplace(p);
+            values[s].swap(v);
+        }
+        versions[s]++;
+    }
+
+    // string keyed access: interns like the old data[key]
+    nlohmann::json& operator[](const std::string& key) { return values[slot(key)]; }
+    void set(const std::string& key, const nlohmann::json& v) { set(slot(key), v); }
+
+    std::size_t size() const { return values.size(); }
+
+private:
+    std::unordered_map<std::string, NDSlot> index;
+    std::vector<const std::string*>         keys;       // slot -> key in index
+    std::vector<nlohmann::json>             values;
+    std::vector<std::uint64_t>              versions;
+};
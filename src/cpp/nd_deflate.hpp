@@ -0,0 +1,96 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+
+// permessage-deflate (RFC 7692) for NDWebSockClient. Full cache inits and
+// query results are bandwidth bound over a VPN, so nd_ws_config swaps
+// websocketpp's default no-op extension for zlib deflate. Whether a msg
+// is compressed is up to the sender: NDWebSockClient::send_now leaves
+// msgs under ws_deflate_min_bytes uncompressed, as deflate costs more
+// latency than it saves on a small frame. What the server sends is the
+// server's call.
+#define ND_WS_DEFLATE_MIN_BYTES 1024
+
+// websock I/O thread only
+struct NDDeflateStats {
+    std::uint64_t   out_raw = 0;        // bytes in to deflate
+    std::uint64_t   out_wire = 0;       // bytes out of deflate
+    std::uint64_t   out_plain = 0;      // bytes sent uncompressed, under the threshold
+    std::uint64_t   in_wire = 0;        // bytes in to inflate
+    std::uint64_t   in_raw = 0;         // bytes out of inflate
+    std::int64_t    deflate_us = 0;
+    std::int64_t    inflate_us = 0;
+};
+
+// The stock extension with counters. websocketpp's processor calls the
+// config's permessage_deflate_type directly, not through a vtable, so
+// hiding compress and decompress here is enough.
+template <typename config>
+class NDDeflate : public websocketpp::extensions::permessage_deflate::enabled<config> {
+    typedef websocketpp::extensions::permessage_deflate::enabled<config> base;
+    typedef std::chrono::steady_clock clock;
+public:
+    websocketpp::lib::error_code compress(std::string const& in, std::string& out) {
+        clock::time_point start(clock::now());
+        std::size_t before = out.size();
+        websocketpp::lib::error_code ec = base::compress(in, out);
+        stats().deflate_us += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+        stats().out_raw += in.size();
+        stats().out_wire += out.size() - before;
+        return ec;
+    }
+
+    // called per frame, appending to out as a fragmented msg arrives
+    websocketpp::lib::error_code decompress(std::uint8_t const* buf, std::size_t len, std::string& out) {
+        clock::time_point start(clock::now());
+        std::size_t before = out.size();
+        websocketpp::lib::error_code ec = base::decompress(buf, len, out);
+        stats().inflate_us += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+        stats().in_wire += len;
+        stats().in_raw += out.size() - before;
+        return ec;
+    }
+
+    // an empty offer means no Sec-WebSocket-Extensions header, so
+    // "ws_deflate":false connects exactly as before
+    std::string generate_offer() const {
+        return offer_enabled() ? base::generate_offer() : std::string();
+    }
+
+    static bool& offer_enabled() { static bool on = true; return on; }
+    static NDDeflateStats& stats() { static NDDeflateStats s; return s; }
+};
+
+// asio_client with NDDeflate, after websocketpp's testee_client example
+struct nd_ws_config : public websocketpp::config::asio_client {
+    typedef nd_ws_config type;
+    typedef websocketpp::config::asio_client base;
+
+    typedef base::concurrency_type concurrency_type;
+    typedef base::request_type request_type;
+    typedef base::response_type response_type;
+    typedef base::message_type message_type;
+    typedef base::con_msg_manager_type con_msg_manager_type;
+    typedef base::endpoint_msg_manager_type endpoint_msg_manager_type;
+    typedef base::alog_type alog_type;
+    typedef base::elog_type elog_type;
+    typedef base::rng_type rng_type;
+
+    struct transport_config : public base::transport_config {
+        typedef type::concurrency_type concurrency_type;
+        typedef type::alog_type alog_type;
+        typedef type::elog_type elog_type;
+        typedef type::request_type request_type;
+        typedef type::response_type response_type;
+        typedef websocketpp::transport::asio::basic_socket::endpoint socket_type;
+    };
+    typedef websocketpp::transport::asio::endpoint<transport_config> transport_type;
+
+    struct permessage_deflate_config {};
+    typedef NDDeflate<permessage_deflate_config> permessage_deflate_type;
+};
+
+typedef nd_ws_config::permessage_deflate_type nd_ws_deflate;
@@ -0,0 +1,54 @@
+#ifdef ND_NATIVE_DUCK
+#include <iostream>
+#include "nd_duck.hpp"
+#include "duckdb/common/arrow/result_arrow_wrapper.hpp"
+#include <arrow/api.h>
+#include <arrow/c/abi.h>
+#include <arrow/c/bridge.h>
+
+// rows per Arrow record batch pulled from a DuckDB result: small
+// enough that the first batch reaches the table widgets quickly
+#define ND_DUCK_BATCH_SIZE 65536
+
+
+NDDuckEngine::NDDuckEngine(std::size_t lane_count)
+    :db(nullptr)
+{
+    for (std::size_t i = 0; i < lane_count; i++) {
+        connections.emplace_back(new duckdb::Connection(db));
+    }
+}
+
+
+bool NDDuckEngine::execute(std::size_t lane_index, const std::string& qid, const std::string& sql)
+{
+    auto result = connections.at(lane_index)->Query(sql);
+    if (result->HasError()) {
+        std::cerr << "NDDuckEngine::execute: " << qid << ": " << result->GetError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+std::shared_ptr<arrow::RecordBatchReader> NDDuckEngine::query(std::size_t lane_index, const std::string& qid, const std::string& sql)
+{
+    static const char* method = "NDDuckEngine::query: ";
+    // SendQuery streams, so each ReadNext pulls the next chunk from
+    // DuckDB rather than materialising the whole result up front
+    auto result = connections.at(lane_index)->SendQuery(sql);
+    if (result->HasError()) {
+        std::cerr << method << qid << ": " << result->GetError() << std::endl;
+        return nullptr;
+    }
+    // the wrapper owns itself via stream.private_data, and is deleted
+    // by the stream's release callback when the reader is done with it
+    auto wrapper = new duckdb::ResultArrowArrayStreamWrapper(std::move(result), ND_DUCK_BATCH_SIZE);
+    auto reader = arrow::ImportRecordBatchReader(&wrapper->stream);
+    if (!reader.ok()) {
+        std::cerr << method << qid << ": " << reader.status().ToString() << std::endl;
+        return nullptr;
+    }
+    return *reader;
+}
+#endif  // ND_NATIVE_DUCK
@@ -0,0 +1,30 @@
+#pragma once
+#ifdef ND_NATIVE_DUCK
+#include <string>
+#include <vector>
+#include <memory>
+#include "duckdb.hpp"
+
+namespace arrow { class RecordBatchReader; }
+
+// In process DuckDB engine for breadboard. When built with ND_NATIVE_DUCK
+// and breadboard.json has "native_duck":true, the duck lanes execute
+// Query and ParquetScan requests here with DuckDB's C++ API instead of
+// going through pyjson and duck_request_f. Each duck lane is a native
+// worker with its own Connection, as a Connection must not be shared
+// across threads. Query results come back as an Arrow RecordBatchReader
+// that NDServer streams to NDContext exactly as it does for the py path.
+// Python remains only for on_data_change business logic.
+class NDDuckEngine {
+public:
+    explicit NDDuckEngine(std::size_t lane_count);
+
+    // duck lane thread: lane_index selects the Connection
+    bool execute(std::size_t lane_index, const std::string& qid, const std::string& sql);
+    std::shared_ptr<arrow::RecordBatchReader> query(std::size_t lane_index, const std::string& qid, const std::string& sql);
+
+private:
+    duckdb::DuckDB                                      db;     // in memory
+    std::vector<std::unique_ptr<duckdb::Connection>>    connections;
+};
+#endif  // ND_NATIVE_DUCK
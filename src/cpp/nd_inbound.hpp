@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include "json.hpp"
+
+// Inbound stage between the lanes' from_python rings and
+// dispatch_server_responses. A backend ticking prices can send many
+// DataChanges per key between two frames, and only the last is ever
+// seen, so here a DataChange replaces any staged DataChange for the
+// same cache_key. Msgs that aren't idempotent, eg DataPatch or the
+// QueryResult stream, are barriers: nothing merges across one, so the
+// order they were sent in holds. Keys that opt out are kept in order,
+// every value, but don't act as barriers. The stage is bounded: when
+// full, the overflow policy either blocks, leaving msgs in the lane
+// rings so the py side backs off, or drops a mergeable DataChange.
+// Barriers and opted out keys are never dropped; with only those to
+// give up, the stage blocks whatever the policy. Keys targeted by
+// DataPatch should opt out: a dropped DataChange would leave a later
+// patch applying to a stale value. Each msg carries the stamp of the
+// request it answers, for dispatch latency; a merged DataChange keeps the
+// stamp it was staged with, so latency counts from the oldest change it
+// stands for.
+// cpp thread only.
+#define ND_INBOUND_MAX  4096
+
+enum NDOverflowPolicy {
+    ND_OVERFLOW_BLOCK,
+    ND_OVERFLOW_DROP_OLDEST,
+    ND_OVERFLOW_DROP_NEWEST
+};
+
+enum NDInboundKind {
+    ND_INBOUND_MERGE,       // DataChange: latest per cache_key wins
+    ND_INBOUND_ORDERED,     // DataChange for an opted out key
+    ND_INBOUND_BARRIER      // anything else
+};
+
+struct NDInboundStats {
+    std::uint64_t   admitted = 0;
+    std::uint64_t   merged = 0;     // replaced a staged DataChange
+    std::uint64_t   dropped = 0;    // overflow policy
+    std::uint64_t   blocked = 0;    // admits refused while full
+    std::uint64_t   barriers = 0;
+    std::uint64_t   dispatched = 0;
+    std::size_t     depth = 0;
+    std::size_t     depth_max = 0;
+};
+
+inline NDOverflowPolicy nd_overflow_policy(const std::string& name)
+{
+    if (name == "drop_oldest") return ND_OVERFLOW_DROP_OLDEST;
+    if (name == "drop_newest") return ND_OVERFLOW_DROP_NEWEST;
+    return ND_OVERFLOW_BLOCK;
+}
+
+class NDInbound {
+public:
+    void configure(std::size_t max, NDOverflowPolicy p) {
+        capacity = max ? max : ND_INBOUND_MAX;
+        policy = p;
+    }
+
+    // false if the stage is full and won't give anything up, in which
+    // case msg is left untouched for a retry
+    bool admit(nlohmann::json& msg, NDInboundKind kind, const std::string& key,
+                std::chrono::steady_clock::time_point stamp) {
+        if (kind == ND_INBOUND_MERGE) {
+            auto it = latest.find(key);
+            if (it != latest.end()) {
+                staged[it->second - base].msg = std::move(msg);
+                stats.merged++;
+                return true;
+            }
+        }
+        if (staged.size() >= capacity) {
+            if (policy == ND_OVERFLOW_DROP_NEWEST && kind == ND_INBOUND_MERGE) {
+                stats.dropped++;
+                return true;
+            }
+            if (policy == ND_OVERFLOW_DROP_OLDEST && staged.front().kind == ND_INBOUND_MERGE) {
+                pop_front();
+                stats.dropped++;
+            }
+            else {
+                stats.blocked++;
+                return false;
+            }
+        }
+        staged.push_back(NDInboundItem{ std::move(msg), kind, key, stamp });
+        if (kind == ND_INBOUND_MERGE) {
+            latest[key] = base + staged.size() - 1;
+        }
+        else if (kind == ND_INBOUND_BARRIER) {
+            // nothing staged ahead of a barrier can take a later value
+            latest.clear();
+            stats.barriers++;
+        }
+        stats.admitted++;
+        stats.depth_max = std::max(stats.depth_max, staged.size());
+        return true;
+    }
+
+    bool pop(nlohmann::json& msg, std::chrono::steady_clock::time_point& stamp) {
+        if (staged.empty()) return false;
+        msg = std::move(staged.front().msg);
+        stamp = staged.front().stamp;
+        pop_front();
+        stats.dispatched++;
+        return true;
+    }
+
+    bool empty() const { return staged.empty(); }
+    bool full() const { return staged.size() >= capacity; }
+
+    NDInboundStats get_stats() const {
+        NDInboundStats s(stats);
+        s.depth = staged.size();
+        return s;
+    }
+
+private:
+    struct NDInboundItem {
+        nlohmann::json  msg;
+        NDInboundKind   kind;
+        std::string     key;
+        std::chrono::steady_clock::time_point   stamp;
+    };
+
+    void pop_front() {
+        NDInboundItem& item(staged.front());
+        if (item.kind == ND_INBOUND_MERGE) {
+            auto it = latest.find(item.key);
+            if (it != latest.end() && it->second == base) latest.erase(it);
+        }
+        staged.pop_front();
+        base++;
+    }
+
+    std::deque<NDInboundItem>                       staged;
+    std::uint64_t                                   base = 0;   // seq of staged.front()
+    std::unordered_map<std::string, std::uint64_t>  latest;     // cache_key -> seq, since the last barrier
+    std::size_t                                     capacity = ND_INBOUND_MAX;
+    NDOverflowPolicy                                policy = ND_OVERFLOW_BLOCK;
+    NDInboundStats                                  stats;
+};
@@ -0,0 +1,58 @@
+#include <cstring>
+#include <iostream>
+#include "nd_ipc.hpp"
+#include <arrow/api.h>
+#include <arrow/io/memory.h>
+#include <arrow/ipc/reader.h>
+
+// arrow::Buffer over memory someone else owns, eg a websocketpp
+// message payload. Slices of it hold a ref to it, so owner lives
+// until the last batch read from the frame is released.
+class NDFrameBuffer : public arrow::Buffer {
+public:
+    NDFrameBuffer(const char* data, std::size_t len, std::shared_ptr<void> o)
+        :arrow::Buffer(reinterpret_cast<const std::uint8_t*>(data), static_cast<std::int64_t>(len)), owner(o) {}
+
+private:
+    std::shared_ptr<void>   owner;
+};
+
+
+bool nd_ipc_frame(const char* data, std::size_t len, NDIPCFrame& frame)
+{
+    static const char* method = "nd_ipc_frame: ";
+    if (len < ND_IPC_HEADER_SZ || std::memcmp(data, ND_IPC_MAGIC, ND_IPC_MAGIC_SZ) != 0) return false;
+    const std::uint8_t* hdr = reinterpret_cast<const std::uint8_t*>(data);
+    if (hdr[4] != ND_IPC_VERSION) {
+        std::cerr << method << "unsupported version " << int(hdr[4]) << std::endl;
+        return false;
+    }
+    frame.flags = hdr[5];
+    std::size_t qid_len = hdr[6] | (hdr[7] << 8);
+    // query_id padded out to keep the IPC body 8 byte aligned
+    frame.body_offset = ND_IPC_HEADER_SZ + ((qid_len + 7) & ~std::size_t(7));
+    if (frame.body_offset > len) {
+        std::cerr << method << "truncated header, " << len << " bytes" << std::endl;
+        return false;
+    }
+    frame.query_id.assign(data + ND_IPC_HEADER_SZ, qid_len);
+    return true;
+}
+
+
+arrow::Status nd_ipc_read(const char* data, std::size_t len, const NDIPCFrame& frame, std::shared_ptr<void> owner,
+                            std::vector<std::shared_ptr<arrow::RecordBatch>>& batches)
+{
+    auto buffer = std::make_shared<NDFrameBuffer>(data + frame.body_offset, len - frame.body_offset, owner);
+    // BufferReader supports zero copy reads, so record batch bodies
+    // come back as slices of buffer rather than fresh allocations
+    auto input = std::make_shared<arrow::io::BufferReader>(buffer);
+    ARROW_ASSIGN_OR_RAISE(auto reader, arrow::ipc::RecordBatchStreamReader::Open(input));
+    std::shared_ptr<arrow::RecordBatch> batch;
+    while (true) {
+        ARROW_RETURN_NOT_OK(reader->ReadNext(&batch));
+        if (!batch) break;
+        batches.push_back(batch);
+    }
+    return arrow::Status::OK();
+}
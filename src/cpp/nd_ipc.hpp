@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace arrow {
+    class RecordBatch;
+    class Status;
+}
+
+// Arrow IPC result frames on the websocket. Rather than serialise a query
+// result row by row into JSON, as duck_module.js materialize() does, the
+// server can send a BINARY frame holding an Arrow IPC stream:
+//
+//  0   "NDAR"          magic, so these never get mistaken for msgpack|cbor
+//  4   u8 version      ND_IPC_VERSION
+//  5   u8 flags        ND_IPC_LAST on the final frame of a result
+//  6   u16 LE          query_id length in bytes
+//  8   query_id        utf8, zero padded to a multiple of 8
+//  ..  IPC stream      schema msg, record batch msgs, optional EOS
+//
+// Each frame is a complete IPC stream, so a large result can go as
+// several frames, and the first rows render before the last arrive. The
+// padding keeps the IPC body 8 byte aligned within the frame. Batches are
+// read in place over the frame payload: their buffers are slices of it,
+// and owner keeps the payload alive for as long as any batch does.
+#define ND_IPC_MAGIC        "NDAR"
+#define ND_IPC_MAGIC_SZ     4
+#define ND_IPC_VERSION      1
+#define ND_IPC_LAST         0x01
+#define ND_IPC_HEADER_SZ    8
+
+struct NDIPCFrame {
+    std::string     query_id;
+    std::uint8_t    flags = 0;
+    std::size_t     body_offset = 0;    // start of the IPC stream
+};
+
+// header only, no arrow: false if this isn't an NDAR frame, or is malformed
+bool nd_ipc_frame(const char* data, std::size_t len, NDIPCFrame& frame);
+
+// read the frame's IPC stream into batches without copying
+arrow::Status nd_ipc_read(const char* data, std::size_t len, const NDIPCFrame& frame, std::shared_ptr<void> owner,
+                            std::vector<std::shared_ptr<arrow::RecordBatch>>& batches);
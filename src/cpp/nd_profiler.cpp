@@ -0,0 +1,93 @@
+#ifdef ND_PROFILER
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "json.hpp"
+#include "nd_profiler.hpp"
+
+
+std::int64_t NDProfileStats::p99(std::vector<std::int64_t>& scratch) const
+{
+    std::size_t n = calls < ND_PROFILE_WINDOW ? static_cast<std::size_t>(calls) : ND_PROFILE_WINDOW;
+    if (!n) return 0;
+    scratch.assign(window, window + n);
+    auto nth = scratch.begin() + static_cast<std::size_t>(0.99 * (n - 1));
+    std::nth_element(scratch.begin(), nth, scratch.end());
+    return *nth;
+}
+
+
+NDProfiler::NDProfiler()
+    :epoch(std::chrono::steady_clock::now()), events(ND_PROFILE_TRACE_EVENTS)
+{
+    scratch.reserve(ND_PROFILE_WINDOW);
+}
+
+
+void NDProfiler::set_key(std::uint32_t node, const char* rname, const std::string& path)
+{
+    if (node >= node_stats.size()) {
+        node_stats.resize(node + 1);
+        node_paths.resize(node + 1);
+        node_rname.resize(node + 1);
+    }
+    node_paths[node] = path;
+    auto it = rname_index.find(rname);
+    if (it == rname_index.end()) {
+        it = rname_index.emplace(rname, static_cast<std::uint32_t>(rname_names.size())).first;
+        rname_names.push_back(it->first.c_str());
+        rname_stats.emplace_back();
+    }
+    node_rname[node] = it->second;
+}
+
+
+void NDProfiler::begin_frame()
+{
+    frame_heads[frame_count++ % ND_PROFILE_TRACE_FRAMES] = event_head;
+    frame_start_ns = now_ns();
+}
+
+
+void NDProfiler::end_frame()
+{
+    trace_event(ND_PROFILE_FRAME_KEY, frame_start_ns, now_ns() - frame_start_ns);
+}
+
+
+bool NDProfiler::dump_trace(const std::string& fname)
+{
+    const static char* method = "NDProfiler::dump_trace: ";
+    if (!frame_count) return false;
+    // oldest frame still in the frame ring, clamped to what the event ring holds
+    std::uint64_t oldest_frame = frame_count > ND_PROFILE_TRACE_FRAMES ? frame_count - ND_PROFILE_TRACE_FRAMES : 0;
+    std::uint64_t begin = frame_heads[oldest_frame % ND_PROFILE_TRACE_FRAMES];
+    if (event_head - begin > ND_PROFILE_TRACE_EVENTS) begin = event_head - ND_PROFILE_TRACE_EVENTS;
+
+    nlohmann::json trace_events = nlohmann::json::array();
+    for (std::uint64_t i = begin; i < event_head; i++) {
+        const NDProfileEvent& ev(events[i % ND_PROFILE_TRACE_EVENTS]);
+        bool frame = ev.key == ND_PROFILE_FRAME_KEY;
+        nlohmann::json te = {
+            {"name", frame ? "frame" : rname_names[node_rname[ev.key]]},
+            {"cat", frame ? "frame" : "widget"},
+            {"ph", "X"},
+            {"ts", ev.start_ns / 1000.0},
+            {"dur", ev.dur_ns / 1000.0},
+            {"pid", 1},
+            {"tid", 1}
+        };
+        if (!frame) te["args"] = { {"path", node_paths[ev.key]} };
+        trace_events.push_back(te);
+    }
+    std::ofstream out(fname);
+    if (!out) {
+        std::cerr << method << "cannot open " << fname << std::endl;
+        return false;
+    }
+    nlohmann::json trace = { {"traceEvents", trace_events}, {"displayTimeUnit", "ms"} };
+    out << trace;
+    std::cout << method << trace_events.size() << " events to " << fname << std::endl;
+    return true;
+}
+#endif
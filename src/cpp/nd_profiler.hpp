@@ -0,0 +1,113 @@
+#pragma once
+// Per widget render profiler: build with ND_PROFILER defined. Without it
+// ND_PROFILE_SCOPE expands to nothing and none of this is compiled, so
+// release builds pay nothing. NDContext::dispatch_render opens a scope per
+// widget, keyed by NDNodeId. As node ids are unique positions in the
+// compiled layout tree, a node id is also a widget path. Each scope feeds
+// the node's stats, its rname's stats, and a ring of trace events covering
+// the last ND_PROFILE_TRACE_FRAMES frames, which dump_trace writes out in
+// Chrome trace_event format for chrome://tracing or Perfetto.
+// Times are inclusive: a Home window's time includes its children.
+
+#ifdef ND_PROFILER
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#define ND_PROFILE_WINDOW       256         // samples per key for p99
+#define ND_PROFILE_TRACE_FRAMES 120
+#define ND_PROFILE_TRACE_EVENTS 65536
+#define ND_PROFILE_FRAME_KEY    0xFFFFFFFF  // trace event key for a whole frame
+
+struct NDProfileStats {
+    std::uint64_t   calls = 0;
+    std::int64_t    total_ns = 0;
+    std::int64_t    max_ns = 0;
+    std::int64_t    window[ND_PROFILE_WINDOW] = {};
+
+    void add(std::int64_t ns) {
+        window[calls++ % ND_PROFILE_WINDOW] = ns;
+        total_ns += ns;
+        if (ns > max_ns) max_ns = ns;
+    }
+    std::int64_t p99(std::vector<std::int64_t>& scratch) const;
+};
+
+struct NDProfileEvent {
+    std::uint32_t   key = 0;        // NDNodeId or ND_PROFILE_FRAME_KEY
+    std::int64_t    start_ns = 0;   // since profiler epoch
+    std::int64_t    dur_ns = 0;
+};
+
+class NDProfiler {
+public:
+    NDProfiler();
+
+    // layout compile time: one call per node
+    void set_key(std::uint32_t node, const char* rname, const std::string& path);
+
+    void begin_frame();
+    void end_frame();
+    std::int64_t now_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+    void record(std::uint32_t node, std::int64_t start_ns, std::int64_t dur_ns) {
+        node_stats[node].add(dur_ns);
+        rname_stats[node_rname[node]].add(dur_ns);
+        trace_event(node, start_ns, dur_ns);
+    }
+
+    // last ND_PROFILE_TRACE_FRAMES frames as Chrome trace_event JSON
+    bool dump_trace(const std::string& fname);
+
+    // overlay access
+    std::size_t node_count() const { return node_stats.size(); }
+    std::size_t rname_count() const { return rname_stats.size(); }
+    const NDProfileStats& get_node_stats(std::size_t i) const { return node_stats[i]; }
+    const NDProfileStats& get_rname_stats(std::size_t i) const { return rname_stats[i]; }
+    const std::string& node_path(std::size_t i) const { return node_paths[i]; }
+    const char* node_rname_name(std::size_t i) const { return rname_names[node_rname[i]]; }
+    const char* rname_name(std::size_t i) const { return rname_names[i]; }
+    std::int64_t p99(const NDProfileStats& stats) { return stats.p99(scratch); }
+
+protected:
+    void trace_event(std::uint32_t key, std::int64_t start_ns, std::int64_t dur_ns) {
+        NDProfileEvent& ev(events[event_head++ % ND_PROFILE_TRACE_EVENTS]);
+        ev.key = key;
+        ev.start_ns = start_ns;
+        ev.dur_ns = dur_ns;
+    }
+
+private:
+    std::chrono::steady_clock::time_point       epoch;
+    std::vector<NDProfileStats>                 node_stats;
+    std::vector<std::string>                    node_paths;
+    std::vector<std::uint32_t>                  node_rname;     // node -> rname index
+    std::vector<NDProfileStats>                 rname_stats;
+    std::vector<const char*>                    rname_names;
+    std::unordered_map<std::string, std::uint32_t> rname_index;
+    // trace ring: frame_heads[f] is event_head when frame f began
+    std::vector<NDProfileEvent>                 events;
+    std::uint64_t                               event_head = 0;
+    std::uint64_t                               frame_heads[ND_PROFILE_TRACE_FRAMES] = {};
+    std::uint64_t                               frame_count = 0;
+    std::int64_t                                frame_start_ns = 0;
+    std::vector<std::int64_t>                   scratch;        // p99
+};
+
+class NDProfileScope {
+public:
+    NDProfileScope(NDProfiler& p, std::uint32_t k) :prof(p), key(k), start_ns(p.now_ns()) {}
+    ~NDProfileScope() { prof.record(key, start_ns, prof.now_ns() - start_ns); }
+private:
+    NDProfiler&     prof;
+    std::uint32_t   key;
+    std::int64_t    start_ns;
+};
+
+#define ND_PROFILE_SCOPE(prof, key) NDProfileScope nd_profile_scope_(prof, key)
+#else
+#define ND_PROFILE_SCOPE(prof, key)
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded single producer, single consumer ring buffer for the C++ <-> py
+// work queues in NDServer. We used to guard a std::queue with a boost::mutex
+// per direction, which meant the render thread could block on from_mutex
+// while the py thread held it marshalling a large response list. Here the
+// producer only ever writes tail and the consumer only ever writes head, so
+// neither side waits on the other. Slots are moved in and moved out, so a
+// nlohmann::json payload is never deep copied on its way through the ring.
+// head and tail live on separate cache lines to avoid false sharing, and
+// each side keeps a private copy of the other side's index so the common
+// case touches only its own line.
+
+#define ND_CACHE_LINE 64
+#define ND_QUEUE_CAPACITY 4096
+
+template <typename T>
+class NDRingBuffer {
+public:
+    // capacity is rounded up to a power of two so we can mask not mod
+    explicit NDRingBuffer(std::size_t capacity = ND_QUEUE_CAPACITY)
+        :head(0), tail_cache(0), tail(0), head_cache(0)
+    {
+        std::size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask = cap - 1;
+        slots.reset(new T[cap]);
+    }
+    NDRingBuffer(const NDRingBuffer&) = delete;
+    NDRingBuffer& operator=(const NDRingBuffer&) = delete;
+
+    // producer thread only: false if the ring is full, in
+    // which case item is left untouched for a retry
+    bool push(T&& item) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache > mask) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache > mask) return false;
+        }
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread only: false if the ring is empty
+    bool pop(T& item) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache) return false;
+        }
+        item = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // safe from either side, but only a snapshot
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+    std::size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    std::size_t capacity() const { return mask + 1; }
+
+private:
+    // consumer owned line
+    alignas(ND_CACHE_LINE) std::atomic<std::size_t>    head;
+    std::size_t                                         tail_cache;
+    // producer owned line
+    alignas(ND_CACHE_LINE) std::atomic<std::size_t>    tail;
+    std::size_t                                         head_cache;
+    // read only after construction
+    alignas(ND_CACHE_LINE) std::size_t                 mask;
+    std::unique_ptr<T[]>                                slots;
+};
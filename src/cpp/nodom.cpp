@@ -13,28 +13,53 @@
 #include <vector>
 #include <filesystem>
 #include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <ctime>
 // nlohmann/json/single_include/nlohmann/json.hpp
 // pybind11
 #include <pybind11/embed.h>
 #include "pybind11_json.hpp"
 #include "nodom.hpp"
+#include "nd_duck.hpp"
 #include <arrow/python/pyarrow.h>
 #include <arrow/api.h>
+#include <arrow/c/abi.h>
+#include <arrow/c/bridge.h>
+#include <arrow/compute/api.h>
+#include <boost/chrono/process_cpu_clocks.hpp>
 
 // Python consts
 static char* on_data_change_cs("on_data_change");
+static char* on_data_changes_cs("on_data_changes");
+static char* on_data_changes_packed_cs("on_data_changes_packed");
 static char* is_duck_app_cs("is_duck_app");
 static char* data_change_cs("DataChange");
 static std::string data_change_s(data_change_cs);
 static char* data_change_confirmed_cs("DataChangeConfirmed");
+static char* data_patch_cs("DataPatch");
+static std::string data_patch_s(data_patch_cs);
+static char* patch_cs("patch");
+static char* op_cs("op");
+static char* from_cs("from");
 static char* new_value_cs("new_value");
 static char* old_value_cs("old_value");
 static char* cache_key_cs("cache_key");
 static char* nd_type_cs("nd_type");
 static char* query_id_cs("query_id");
+static char* query_result_cs("QueryResult");
+static std::string query_result_s(query_result_cs);
+static char* result_cs("result");
+static char* query_result_batch_cs("QueryResultBatch");
+static char* query_result_end_cs("QueryResultEnd");
+static char* batch_cs("batch");
+static char* error_cs("error");
+static char* arrow_c_stream_cs("__arrow_c_stream__");
+static char* arrow_array_stream_cs("arrow_array_stream");
 static char* __nodom__cs("__nodom__");
 static char* sys_cs("sys");
 static char* sql_cs("sql");
+static char* lane_key_cs("lane_key");
 static char* cspec_cs("cspec");
 static char* cname_cs("cname");
 static char* title_cs("title");
@@ -51,7 +76,9 @@ static char* font_size_base_cs("font_size_base");
 
 
 NDServer::NDServer(int argc, char** argv)
-    :is_duck_app(false), done(false)
+    :py_encoding(ND_ENC_JSON), is_duck_app(false), done(false), main_tstate(nullptr),
+    coalesce_max_delay_ms(ND_COALESCE_MAX_DELAY_MS), notify_count(0), coalesced_count(0),
+    patch_min_elements(ND_PATCH_MIN_ELEMENTS), patch_count(0), patch_bytes_saved(0), patch_diff_us(0)
 {
     std::string usage("breadboard <breadboard_config_json_path> <test_dir>");
     if (argc < 3) {
@@ -78,6 +105,40 @@ NDServer::NDServer(int argc, char** argv)
         exit(1);
     }
 
+    // DataChange coalescing: 0 ms max delay switches it off, and keys
+    // whose intermediate values matter can opt out individually
+    coalesce_max_delay_ms = bb_config.value("coalesce_max_delay_ms", ND_COALESCE_MAX_DELAY_MS);
+    if (bb_config.contains("coalesce_opt_out")) {
+        for (auto& ckey : bb_config["coalesce_opt_out"]) {
+            coalesce_opt_out.insert(ckey.get<std::string>());
+        }
+    }
+
+    // inbound stage: DataChanges from py merge per cache_key between
+    // frames, except for keys whose every value matters
+    inbound.configure(bb_config.value("inbound_max", ND_INBOUND_MAX),
+                        nd_overflow_policy(bb_config.value("inbound_overflow", "block")));
+    if (bb_config.contains("inbound_opt_out")) {
+        for (auto& ckey : bb_config["inbound_opt_out"]) {
+            inbound_opt_out.insert(ckey.get<std::string>());
+        }
+    }
+
+    patch_min_elements = bb_config.value("patch_min_elements", ND_PATCH_MIN_ELEMENTS);
+
+    // DataChange batches can cross the py boundary as one msgpack|cbor
+    // bytes object rather than a list of dicts built by pyjson, if the
+    // py service defines on_data_changes_packed
+    py_encoding = nd_encoding(bb_config.value("py_encoding", "json"));
+
+    // lane 0 is the low latency DataChange lane, then one or more duck
+    // lanes so DB work can't hold up UI DataChanges
+    lanes.emplace_back(new NDLane("ui", 0));
+    int duck_lanes = std::max(1, bb_config.value("duck_lanes", 1));
+    for (int i = 0; i < duck_lanes; i++) {
+        lanes.emplace_back(new NDLane("duck" + std::to_string(i), lanes.size()));
+    }
+
     // figure out the module from test name
     std::filesystem::path test_path(test_dir);
     test_module_name = test_path.stem().string();
@@ -131,6 +192,20 @@ bool NDServer::init_python()
         auto test_module = pybind11::module_::import(test_module_name.c_str());
         pybind11::object service = test_module.attr(service_cs);
         on_data_change_f = service.attr(on_data_change_cs);
+        // batched entry point is optional: python_thread falls
+        // back to one on_data_change call per DataChange
+        if (pybind11::hasattr(service, on_data_changes_cs)) {
+            on_data_changes_f = service.attr(on_data_changes_cs);
+        }
+        if (nd_binary_encoding(py_encoding)) {
+            if (pybind11::hasattr(service, on_data_changes_packed_cs)) {
+                on_data_changes_packed_f = service.attr(on_data_changes_packed_cs);
+            }
+            else {
+                std::cerr << "NDServer::init_python: py_encoding " << nd_encoding_names[py_encoding]
+                    << " but no " << on_data_changes_packed_cs << ", using pyjson" << std::endl;
+            }
+        }
         is_duck_app = pybind11::bool_(service.attr(is_duck_app_cs));
 
         if (is_duck_app) {
@@ -178,14 +253,31 @@ bool NDServer::load_json()
 }
 
 
-void NDServer::marshall_server_responses(pybind11::list& server_responses_p, nlohmann::json& server_responses_j, const std::string& type_filter)
+void NDServer::marshall_server_responses(NDLane& lane, pybind11::list& server_responses_p, nlohmann::json& server_responses_j, const std::string& type_filter)
 {
     static const char* method = "NDServer::marshall_server_responses: ";
     // TODO: a better STLish predicate based filtering mechanism. Maybe a lambda as param?
     for (int i = 0; i < server_responses_p.size(); i++) {
         pybind11::dict change_p = server_responses_p[i];
         std::string nd_type = pyjson::to_json(change_p[nd_type_cs]);
-        if (nd_type == type_filter || type_filter.empty()) {
+        // a DataPatch is a DataChange as far as filtering goes
+        if (nd_type == type_filter || type_filter.empty() || (type_filter == data_change_s && nd_type == data_patch_s)) {
+            if (nd_type == query_result_s && change_p.contains(result_cs)) {
+                // Arrow results don't go through pyjson: they're streamed
+                // to the cpp thread as QueryResultBatch msgs instead
+                std::string qid = pyjson::to_json(change_p[query_id_cs]);
+                auto reader = import_arrow_result(qid, change_p[result_cs]);
+                {
+                    // ReadNext blocks on the producer for as long as the query runs,
+                    // and publish_python sleeps while the lane ring is full, so drop
+                    // the GIL while streaming. A py backed stream takes the GIL in its
+                    // own callbacks. reader outlives this scope, so the stream is
+                    // released with the GIL held.
+                    pybind11::gil_scoped_release release;
+                    stream_arrow_result(lane, qid, reader, server_responses_j);
+                }
+                continue;
+            }
             nlohmann::json change_j(pyjson::to_json(change_p));
             std::cout << method << change_j << server_responses_j.size() << std::endl;
             server_responses_j.push_back(change_j);
@@ -195,12 +287,129 @@ void NDServer::marshall_server_responses(pybind11::list& server_responses_p, nlo
 }
 
 
-void NDServer::get_server_responses(std::queue<nlohmann::json>& responses)
+std::shared_ptr<arrow::RecordBatchReader> NDServer::import_arrow_result(const std::string& qid, pybind11::object result_p)
+{
+    static const char* method = "NDServer::import_arrow_result: ";
+    // caller holds the GIL. Any producer of the Arrow PyCapsule interface will
+    // do: pyarrow.Table, RecordBatchReader, or a DuckDB relation. We import the
+    // ArrowArrayStream once, and from there on record batches are shared_ptr
+    // owned, so the DuckDB buffers go all the way to render without a copy.
+    if (!pybind11::hasattr(result_p, arrow_c_stream_cs)) {
+        std::cerr << method << qid << ": result does not export " << arrow_c_stream_cs << std::endl;
+        return nullptr;
+    }
+    pybind11::object capsule = result_p.attr(arrow_c_stream_cs)();
+    auto stream = reinterpret_cast<ArrowArrayStream*>(PyCapsule_GetPointer(capsule.ptr(), arrow_array_stream_cs));
+    if (!stream) {
+        PyErr_Clear();
+        std::cerr << method << qid << ": bad " << arrow_array_stream_cs << " capsule" << std::endl;
+        return nullptr;
+    }
+    // ImportRecordBatchReader moves the stream, leaving the
+    // capsule's copy released for its destructor
+    auto reader = arrow::ImportRecordBatchReader(stream);
+    if (!reader.ok()) {
+        std::cerr << method << qid << ": " << reader.status().ToString() << std::endl;
+        return nullptr;
+    }
+    return *reader;
+}
+
+
+void NDServer::stream_arrow_result(NDLane& lane, const std::string& qid, std::shared_ptr<arrow::RecordBatchReader> reader,
+                                    nlohmann::json& response_list_j)
+{
+    static const char* method = "NDServer::stream_arrow_result: ";
+    // caller must not hold the GIL: this runs as long as the query does
+    // responses marshalled ahead of this result go first, so
+    // ordering within the lane holds
+    for (auto& resp : response_list_j) {
+        publish_python(lane, resp, lane.batch_stamp);
+    }
+    response_list_j.clear();
+
+    std::int64_t rows = 0;
+    std::int64_t batches = 0;
+    nlohmann::json end_j = { {nd_type_cs, query_result_end_cs}, {query_id_cs, qid} };
+    std::shared_ptr<arrow::RecordBatch> batch;
+    while (reader) {
+        auto status = reader->ReadNext(&batch);
+        if (!status.ok()) {
+            std::cerr << method << qid << ": " << status.ToString() << std::endl;
+            end_j[error_cs] = status.ToString();
+            break;
+        }
+        if (!batch) break;
+        rows += batch->num_rows();
+        // publish each batch as soon as it's read, and wake the cpp
+        // thread so the table widgets can render the rows we have
+        nlohmann::json batch_j = { {nd_type_cs, query_result_batch_cs}, {query_id_cs, qid},
+                                    {batch_cs, handoff.stage(batch)}, {"seq", batches++} };
+        publish_python(lane, batch_j, lane.batch_stamp);
+        if (response_callback) response_callback();
+    }
+    if (!reader) end_j[error_cs] = "no result stream";
+    end_j["rows"] = rows;
+    end_j["batches"] = batches;
+    std::cout << method << qid << ": " << rows << " rows in " << batches << " batches" << std::endl;
+    // end marker goes out with the rest of the lane's responses
+    response_list_j.push_back(end_j);
+}
+
+
+std::uint64_t NDArrowHandoff::stage(std::shared_ptr<arrow::RecordBatch> batch)
 {
-    static const char* method = "NDServer::get_server_responses: ";
-    boost::unique_lock<boost::mutex> from_lock(from_mutex);
-    from_python.swap(responses);
-    std::cout << method << responses.size() << " responses" << std::endl;
+    boost::lock_guard<boost::mutex> lock(mutex);
+    std::uint64_t handle = next_handle++;
+    staged[handle] = batch;
+    return handle;
+}
+
+
+std::shared_ptr<arrow::RecordBatch> NDArrowHandoff::take(std::uint64_t handle)
+{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    auto it = staged.find(handle);
+    if (it == staged.end()) return nullptr;
+    std::shared_ptr<arrow::RecordBatch> batch(std::move(it->second));
+    staged.erase(it);
+    return batch;
+}
+
+
+bool NDServer::pull_server_responses()
+{
+    static const char* method = "NDServer::pull_server_responses: ";
+    // consumer side of from_python: no lock, so we cannot be held up
+    // by the py thread marshalling a long response list
+    auto now = std::chrono::steady_clock::now();
+    std::uint64_t pulled = 0;
+    std::string key;
+    for (auto& lane : lanes) {
+        // a msg the stage refused last time goes first, so lane order holds
+        while (lane->holding || lane->from_python.pop(lane->held)) {
+            lane->holding = true;
+            nlohmann::json& msg(lane->held.msg);
+            NDInboundKind kind = ND_INBOUND_BARRIER;
+            key.clear();
+            if (msg.value(nd_type_cs, "") == data_change_s && msg.contains(cache_key_cs)) {
+                key = msg[cache_key_cs].get<std::string>();
+                kind = inbound_opt_out.count(key) ? ND_INBOUND_ORDERED : ND_INBOUND_MERGE;
+            }
+            // full: the rest stay in the ring, and the lane backs off
+            if (!inbound.admit(msg, kind, key, lane->held.stamp)) break;
+            lane->holding = false;
+            // notify_server to inbound stage; sample_dispatch has the rest
+            stage_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(now - lane->held.stamp).count());
+            pulled++;
+        }
+    }
+    if (pulled) {
+        std::cout << method << pulled << " responses" << std::endl;
+    }
+    // py thread may have gone idle since the last notify
+    flush_notifications(false);
+    return !inbound.empty();
 }
 
 
@@ -208,33 +417,157 @@ void NDServer::notify_server(const std::string& caddr, nlohmann::json& old_val,
 {
     std::cout << "cpp: notify_server: " << caddr << ", old: " << old_val << ", new: " << new_val << std::endl;
 
-    // build a JSON msg for the to_python Q
-    nlohmann::json msg = { {nd_type_cs, data_change_cs}, {cache_key_cs, caddr}, {new_value_cs, new_val}, {old_value_cs, old_val} };
-    try {
-        // grab lock for this Q: should be free as ::python_thread should be in to_cond.wait()
-        boost::unique_lock<boost::mutex> to_lock(to_mutex);
-        to_python.push(msg);
+    notify_count++;
+    auto now = std::chrono::steady_clock::now();
+    if (coalesce_max_delay_ms <= 0 || coalesce_opt_out.count(caddr)) {
+        // flush first so the opted out change can't overtake earlier ones
+        flush_notifications(true);
+        nlohmann::json msg(data_change_msg(caddr, old_val, new_val));
+        enqueue_python(msg, now);
+        return;
     }
-    catch (...) {
-        std::cerr << "notify_server EXCEPTION!" << std::endl;
+    // coalesce: keep the first old_value and the latest new_value
+    // per cache_key until the py thread is ready for them
+    auto it = coalesced.find(caddr);
+    if (it != coalesced.end()) {
+        it->second.new_value = new_val;
+        coalesced_count++;
     }
-    // lock is out of scope so released: signal py thread to wake up
-    to_cond.notify_one();
+    else {
+        if (coalesced.empty()) coalesce_start = now;
+        coalesced.emplace(caddr, NDCoalescedChange{ old_val, new_val, now });
+        coalesced_order.push_back(caddr);
+    }
+    flush_notifications(false);
+}
+
+void NDServer::flush_notifications(bool force)
+{
+    // called every frame, and as responses land, so parked msgs
+    // move as soon as their lane has room
+    unpark_python();
+    if (coalesced_order.empty()) return;
+    // the DataChange lane is ready when it's waiting on an empty to_python,
+    // otherwise we hold changes back for at most coalesce_max_delay_ms
+    NDLane& ui_lane(*lanes[0]);
+    bool py_ready = !ui_lane.busy && ui_lane.to_python.empty() && ui_lane.parked.empty();
+    auto held_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - coalesce_start).count();
+    if (!force && !py_ready && held_ms < coalesce_max_delay_ms) return;
+    // build JSON msgs for the to_python Q in first notify order
+    for (auto& caddr : coalesced_order) {
+        NDCoalescedChange& change(coalesced[caddr]);
+        nlohmann::json msg(data_change_msg(caddr, std::move(change.old_value), std::move(change.new_value)));
+        enqueue_python(msg, change.stamp);
+    }
+    coalesced.clear();
+    coalesced_order.clear();
+}
+
+nlohmann::json NDServer::data_change_msg(const std::string& caddr, nlohmann::json old_val, nlohmann::json new_val)
+{
+    // a big list or object edited in one place goes as a diff, if
+    // that's the smaller, rather than resending the lot
+    if (patch_min_elements && new_val.is_structured() && old_val.type() == new_val.type()
+                            && new_val.size() >= patch_min_elements) {
+        auto start = std::chrono::steady_clock::now();
+        nlohmann::json patch(nlohmann::json::diff(old_val, new_val));
+        std::size_t patch_bytes = patch.dump().size();
+        std::size_t full_bytes = new_val.dump().size();
+        patch_diff_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        if (patch_bytes < full_bytes) {
+            patch_count++;
+            patch_bytes_saved += full_bytes - patch_bytes;
+            return { {nd_type_cs, data_patch_cs}, {cache_key_cs, caddr}, {patch_cs, std::move(patch)} };
+        }
+    }
+    return { {nd_type_cs, data_change_cs}, {cache_key_cs, caddr},
+                {new_value_cs, std::move(new_val)}, {old_value_cs, std::move(old_val)} };
 }
 
 void NDServer::duck_dispatch(nlohmann::json& db_request)
 {
     std::cout << "cpp: duck_dispatch: " << db_request << std::endl;
-    try {
-        // grab lock for this Q: should be free as ::python_thread should be in to_cond.wait()
-        boost::unique_lock<boost::mutex> to_lock(to_mutex);
-        to_python.push(db_request);
+    // DataChanges held for coalescing go ahead of the DB request
+    flush_notifications(true);
+    enqueue_python(db_request, std::chrono::steady_clock::now());
+}
+
+NDLane& NDServer::lane_for(const nlohmann::json& msg)
+{
+    // DataChanges take the low latency lane. DB requests are order
+    // dependent, eg a Query on the view a ParquetScan creates, so they
+    // all go to duck0 unless the layout's db op gives a lane_key. Requests
+    // with a lane_key are independent of any other lane_key, and are
+    // spread over the duck lanes by it; one lane_key stays in order.
+    const std::string nd_type(msg.value(nd_type_cs, ""));
+    if (nd_type == data_change_s || nd_type == data_patch_s || lanes.size() == 1) {
+        return *lanes[0];
     }
-    catch (...) {
-        std::cerr << "duck_dispatch EXCEPTION!" << std::endl;
+    const std::string lane_key(msg.value(lane_key_cs, ""));
+    if (lane_key.empty()) return *lanes[1];
+    std::size_t duck_lanes = lanes.size() - 1;
+    std::size_t khash = std::hash<std::string>{}(lane_key);
+    return *lanes[1 + khash % duck_lanes];
+}
+
+void NDServer::enqueue_python(nlohmann::json& msg, std::chrono::steady_clock::time_point stamp)
+{
+    NDLane& lane(lane_for(msg));
+    // producer side of lane.to_python: never blocks the cpp thread. A full
+    // ring parks the msg rather than dropping it, as it's the user's intent.
+    // Once anything is parked, later msgs park behind it so lane order holds.
+    NDWorkItem item{ std::move(msg), stamp };
+    if (!lane.parked.empty() || !lane.to_python.push(std::move(item))) {
+        if (lane.parked.empty()) {
+            std::cerr << "NDServer::enqueue_python: " << lane.name << " to_python full at "
+                << lane.to_python.capacity() << ", parking" << std::endl;
+        }
+        lane.parked.push_back(std::move(item));
+    }
+    wake_python(lane);
+}
+
+void NDServer::unpark_python()
+{
+    // retry parked msgs in order as the lanes drain to_python
+    for (auto& lane : lanes) {
+        if (lane->parked.empty()) continue;
+        while (!lane->parked.empty() && lane->to_python.push(std::move(lane->parked.front()))) {
+            lane->parked.pop_front();
+        }
+        wake_python(*lane);
+    }
+}
+
+void NDServer::wake_python(NDLane& lane)
+{
+    // lane_loop checks its wait predicate under to_mutex, so passing through
+    // to_mutex here means the notify cannot land between the predicate check
+    // and the wait. The py thread never holds to_mutex while marshalling.
+    {
+        boost::lock_guard<boost::mutex> to_lock(lane.to_mutex);
+    }
+    lane.to_cond.notify_one();
+}
+
+void NDServer::set_done(bool d)
+{
+    done = d;
+    for (auto& lane : lanes) {
+        wake_python(*lane);
+    }
+}
+
+void NDServer::publish_python(NDLane& lane, nlohmann::json& resp, std::chrono::steady_clock::time_point stamp)
+{
+    // producer side of lane.from_python: the py thread may back off
+    // while the render thread catches up, but the reverse never happens
+    NDWorkItem item{ std::move(resp), stamp };
+    while (!lane.from_python.push(std::move(item))) {
+        if (done) return;
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
     }
-    // lock is out of scope so released: signal py thread to wake up
-    to_cond.notify_one();
 }
 
 void NDServer::python_thread()
@@ -246,6 +579,36 @@ void NDServer::python_thread()
     if (!init_python()) exit(1);
     std::cout << method << "init done" << std::endl;
 
+    // Py_InitializeFromConfig leaves this thread holding the GIL. The duck
+    // lanes need it too, so release it here; lane_loop takes it per batch.
+    main_tstate = PyEval_SaveThread();
+#ifdef ND_NATIVE_DUCK
+    // native engine takes DB work off the py path entirely; its
+    // connections map one to one onto the duck lanes
+    if (is_duck_app && bb_config.value("native_duck", false)) {
+        std::cout << method << "native duck engine" << std::endl;
+        native_duck.reset(new NDDuckEngine(lanes.size()));
+    }
+#endif
+    for (std::size_t i = 1; i < lanes.size(); i++) {
+        lanes[i]->thread = boost::thread(&NDServer::lane_loop, this, lanes[i].get());
+    }
+
+    // this thread serves the low latency DataChange lane
+    lane_loop(lanes[0].get());
+
+    for (std::size_t i = 1; i < lanes.size(); i++) {
+        lanes[i]->thread.join();
+    }
+    PyEval_RestoreThread(main_tstate);
+    fini_python();
+}
+
+void NDServer::lane_loop(NDLane* lane)
+{
+    const static char* method = "NDServer::lane_loop: ";
+
+    std::cout << method << lane->name << " starting..." << std::endl;
     nlohmann::json response_list_j = nlohmann::json::array();
 
     // https://www.boost.org/doc/libs/1_34_0/doc/html/boost/condition.html
@@ -258,58 +621,257 @@ void NDServer::python_thread()
     // wait functions the mutex object is again locked. The tricky unlock/lock sequence is performed
     // automatically by the condition object's wait functions.
 
+    NDWorkItem item;
+    std::vector<nlohmann::json> batch;
     while (!done) {
-        boost::unique_lock<boost::mutex> to_lock(to_mutex);
-        to_cond.wait(to_lock);
-        // thead quiesces in the wait above, with to_mutex
-        // unlocked so the C++ thread can add work items
-        std::cout << method << "to_python depth : " << to_python.size() << std::endl;
-        while (!to_python.empty()) {
-            nlohmann::json msg(to_python.front());
-            to_python.pop();
-            if (!msg.contains(nd_type_cs)) {
-                std::cerr << method << "nd_type missing: " << msg << std::endl;
-                continue;
-            }
-            std::string nd_type(msg[nd_type_cs]);
-            if (nd_type == data_change_s) {
-                try {
-                    pybind11::gil_scoped_acquire acquire;
-                    // explicitly avoiding move ctor here rather than using "pyjson::from_json(msg)"
-                    // as param 2 into on_data_change_f threw an exception...
-                    pybind11::dict data_change_dict(pyjson::from_json(msg));
-                    pybind11::list response_list_p = on_data_change_f(breadboard_cs, data_change_dict);
-                    marshall_server_responses(response_list_p, response_list_j, data_change_s);
+        {
+            // predicate wait: a notify that lands while we're draining is
+            // not lost, as we recheck to_python before sleeping again
+            boost::unique_lock<boost::mutex> to_lock(lane->to_mutex);
+            lane->to_cond.wait(to_lock, [this, lane] { return done || !lane->to_python.empty(); });
+        }
+        // thead quiesces in the wait above; to_mutex is released before
+        // we drain so the C++ thread never waits on marshalling
+        std::cout << method << lane->name << " to_python depth : " << lane->to_python.size() << std::endl;
+        // drain to_python fully before going near the GIL so a burst
+        // of DataChanges costs one acquisition, not one per msg.
+        // Responses are stamped with the oldest request in the batch.
+        std::chrono::steady_clock::time_point batch_stamp;
+        while (lane->to_python.pop(item)) {
+            if (batch.empty()) batch_stamp = item.stamp;
+            batch.push_back(std::move(item.msg));
+        }
+        if (batch.empty()) continue;
+        lane->busy = true;
+        lane->batch_stamp = batch_stamp;
+        std::int64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - batch_stamp).count();
+        lane->last_wait_us = wait_us;
+        if (wait_us > lane->max_wait_us) lane->max_wait_us = wait_us;
+#ifdef ND_NATIVE_DUCK
+        if (native_duck && lane->index > 0) {
+            // native duck lane: no GIL and no pyjson round trip
+            for (auto& msg : batch) native_request(*lane, msg, response_list_j);
+            lane->batches++;
+            lane->messages += batch.size();
+        }
+        else
+#endif
+        service_batch(*lane, batch, response_list_j);
+        lane->last_exec_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - batch_stamp).count() - wait_us;
+        batch.clear();
+        // enqueue the changes on the lock free response Q, then clear
+        // the local response Q before another go around
+        for (auto& resp : response_list_j) {
+            std::cout << method << lane->name << ": " << resp << std::endl;
+            publish_python(*lane, resp, batch_stamp);
+        }
+        // tell the cpp thread it has work rather than waiting for a poll
+        lane->busy = false;
+        if (!response_list_j.empty() && response_callback) {
+            response_callback();
+        }
+        response_list_j.clear();
+    }
+}
+
+
+void NDServer::service_batch(NDLane& lane, std::vector<nlohmann::json>& batch, nlohmann::json& response_list_j)
+{
+    const static char* method = "NDServer::service_batch: ";
+    std::uint64_t py_calls = 0;
+    // one GIL acquisition covers the whole batch
+    pybind11::gil_scoped_acquire acquire;
+    // DataChanges accumulate here when service.on_data_changes is defined
+    pybind11::list data_changes_p;
+    // or here, untouched by pyjson, when on_data_changes_packed is
+    nlohmann::json data_changes_j = nlohmann::json::array();
+    for (auto& msg : batch) {
+        if (!msg.contains(nd_type_cs)) {
+            std::cerr << method << "nd_type missing: " << msg << std::endl;
+            continue;
+        }
+        std::string nd_type(msg[nd_type_cs]);
+        try {
+            if (nd_type == data_change_s || nd_type == data_patch_s) {
+                if (on_data_changes_packed_f) {
+                    data_changes_j.push_back(std::move(msg));
+                    continue;
                 }
-                catch (pybind11::error_already_set& ex) {
-                    std::cerr << method << nd_type << ": " << ex.what() << std::endl;
+                // explicitly avoiding move ctor here rather than using "pyjson::from_json(msg)"
+                // as param 2 into on_data_change_f threw an exception...
+                pybind11::dict data_change_dict(pyjson::from_json(msg));
+                if (on_data_changes_f) {
+                    data_changes_p.append(data_change_dict);
                     continue;
                 }
+                py_calls++;
+                pybind11::list response_list_p = on_data_change_f(breadboard_cs, data_change_dict);
+                marshall_server_responses(lane, response_list_p, response_list_j, data_change_s);
             }
             else {
+                // not a DataChange, so must be DB. Duck requests are not batched, so
+                // flush any DataChanges ahead of this one to preserve Q ordering.
+                // A throw from on_data_changes must not cost us the DB request.
                 try {
-                    pybind11::gil_scoped_acquire acquire;
-                    pybind11::dict duck_request_dict(pyjson::from_json(msg));
-                    // not a DataChange, so must be DB
-                    pybind11::list response_list_p = duck_request_f(duck_request_dict);
-                    marshall_server_responses(response_list_p, response_list_j, empty_cs);
+                    flush_data_changes(lane, data_changes_p, response_list_j, py_calls);
+                    flush_packed_changes(lane, data_changes_j, response_list_j, py_calls);
                 }
                 catch (pybind11::error_already_set& ex) {
-                    std::cerr << method << nd_type << ": " << ex.what() << std::endl;
+                    std::cerr << method << on_data_changes_cs << ": " << ex.what() << std::endl;
+                }
+                if (!duck_request_f) {
+                    std::cerr << method << lane.name << ": not a duck app, dropping: " << msg << std::endl;
                     continue;
                 }
+                pybind11::dict duck_request_dict(pyjson::from_json(msg));
+                py_calls++;
+                pybind11::list response_list_p = duck_request_f(duck_request_dict);
+                marshall_server_responses(lane, response_list_p, response_list_j, empty_cs);
             }
-            // lock response Q and enqueue the changes, then clear the local
-            // response Q before another go around
-            boost::unique_lock<boost::mutex> from_lock(from_mutex);
-            for (auto resp : response_list_j) {
-                std::cout << method << resp << std::endl;
-                from_python.push(resp);
-            }
-            response_list_j.clear();
+        }
+        catch (pybind11::error_already_set& ex) {
+            std::cerr << method << nd_type << ": " << ex.what() << std::endl;
         }
     }
-    fini_python();
+    try {
+        flush_data_changes(lane, data_changes_p, response_list_j, py_calls);
+        flush_packed_changes(lane, data_changes_j, response_list_j, py_calls);
+    }
+    catch (pybind11::error_already_set& ex) {
+        std::cerr << method << on_data_changes_cs << ": " << ex.what() << std::endl;
+    }
+    lane.batches++;
+    lane.messages += batch.size();
+    lane.py_calls += py_calls;
+    std::cout << method << lane.name << ": " << batch.size() << " msgs, " << py_calls << " py calls, saved "
+        << batch.size() - py_calls << " py calls and " << batch.size() - 1 << " GIL acquisitions" << std::endl;
+}
+
+
+void NDServer::flush_data_changes(NDLane& lane, pybind11::list& data_changes_p, nlohmann::json& response_list_j, std::uint64_t& py_calls)
+{
+    // caller holds the GIL
+    if (data_changes_p.empty()) return;
+    pybind11::list changes_p(data_changes_p);
+    data_changes_p = pybind11::list();
+    py_calls++;
+    pybind11::list response_list_p = on_data_changes_f(breadboard_cs, changes_p);
+    marshall_server_responses(lane, response_list_p, response_list_j, data_change_s);
+}
+
+
+void NDServer::flush_packed_changes(NDLane& lane, nlohmann::json& data_changes_j, nlohmann::json& response_list_j, std::uint64_t& py_calls)
+{
+    static const char* method = "NDServer::flush_packed_changes: ";
+    // caller holds the GIL
+    if (data_changes_j.empty()) return;
+    nd_encode(data_changes_j, py_encoding, packed_buf);
+    data_changes_j = nlohmann::json::array();
+    py_calls++;
+    lane.packed_bytes += packed_buf.size();
+    pybind11::object result_p = on_data_changes_packed_f(breadboard_cs,
+                pybind11::bytes(packed_buf.data(), packed_buf.size()), nd_encoding_names[py_encoding]);
+    // the service may answer in kind, or with the usual list of dicts
+    if (!pybind11::isinstance<pybind11::bytes>(result_p)) {
+        pybind11::list response_list_p(result_p);
+        marshall_server_responses(lane, response_list_p, response_list_j, data_change_s);
+        return;
+    }
+    char* data = nullptr;
+    Py_ssize_t len = 0;
+    PyBytes_AsStringAndSize(result_p.ptr(), &data, &len);
+    lane.packed_bytes += len;
+    nlohmann::json responses_j;
+    try {
+        responses_j = nd_decode(data, static_cast<std::size_t>(len), py_encoding);
+    }
+    catch (nlohmann::json::exception& ex) {
+        std::cerr << method << ex.what() << std::endl;
+        return;
+    }
+    for (auto& resp : responses_j) {
+        const std::string nd_type(resp.value(nd_type_cs, ""));
+        if (nd_type == data_change_s || nd_type == data_patch_s) {
+            response_list_j.push_back(std::move(resp));
+        }
+    }
+}
+
+
+#ifdef ND_NATIVE_DUCK
+void NDServer::native_request(NDLane& lane, nlohmann::json& msg, nlohmann::json& response_list_j)
+{
+    static const char* method = "NDServer::native_request: ";
+    if (!msg.contains(sql_cs) || !msg.contains(query_id_cs)) {
+        std::cerr << method << "missing sql|query_id in: " << msg << std::endl;
+        return;
+    }
+    const std::string& nd_type(msg[nd_type_cs]);
+    const std::string& qid(msg[query_id_cs]);
+    const std::string& sql(msg[sql_cs]);
+    // same response shapes as duck_module's py service
+    if (nd_type == "ParquetScan") {
+        if (native_duck->execute(lane.index, qid, sql)) {
+            response_list_j.push_back({ {nd_type_cs, "ParquetScanResult"}, {query_id_cs, qid} });
+        }
+    }
+    else if (nd_type == "Query") {
+        stream_arrow_result(lane, qid, native_duck->query(lane.index, qid, sql), response_list_j);
+    }
+    else {
+        std::cerr << method << "unexpected nd_type in: " << msg << std::endl;
+    }
+}
+#endif
+
+
+void NDServer::get_lane_stats(std::vector<NDLaneStats>& stats)
+{
+    stats.clear();
+    for (auto& lane : lanes) {
+        NDLaneStats ls;
+        ls.name = lane->name;
+        ls.depth = lane->to_python.size() + lane->parked.size();
+        ls.batches = lane->batches;
+        ls.messages = lane->messages;
+        ls.last_wait_us = lane->last_wait_us;
+        ls.max_wait_us = lane->max_wait_us;
+        ls.last_exec_us = lane->last_exec_us;
+        stats.push_back(ls);
+    }
+}
+
+
+NDLatencyStats NDServer::get_latency_stats()
+{
+    NDLatencyStats stats;
+    stats.samples = latency.count;
+    stats.p50_us = latency.percentile(0.5);
+    stats.p99_us = latency.percentile(0.99);
+    stats.staged_p50_us = stage_latency.percentile(0.5);
+    stats.staged_p99_us = stage_latency.percentile(0.99);
+    return stats;
+}
+
+
+NDBatchStats NDServer::get_batch_stats()
+{
+    NDBatchStats stats;
+    for (auto& lane : lanes) {
+        stats.batches += lane->batches;
+        stats.messages += lane->messages;
+        stats.py_calls += lane->py_calls;
+        stats.packed_bytes += lane->packed_bytes;
+    }
+    stats.py_encoding = on_data_changes_packed_f ? py_encoding : ND_ENC_JSON;
+    stats.notifications = notify_count;
+    stats.coalesced = coalesced_count;
+    stats.patches = patch_count;
+    stats.patch_bytes_saved = patch_bytes_saved;
+    stats.diff_us = patch_diff_us;
+    return stats;
 }
 
 
@@ -322,64 +884,310 @@ NDContext::NDContext(NDServer& s)
     // emulate the main.ts NDContext fetch from server side
     std::string layout_s = server.fetch("layout");
     layout = nlohmann::json::parse(layout_s);
-    data = nlohmann::json::parse(server.fetch("data"));
+    data.load(nlohmann::json::parse(server.fetch("data")));
+
+    // map layout render func names to the actual C++ impls
+    rfmap.emplace(std::string("Home"), &NDContext::render_home);
+    rfmap.emplace(std::string("InputInt"), &NDContext::render_input_int);
+    rfmap.emplace(std::string("Combo"), &NDContext::render_combo);
+    rfmap.emplace(std::string("Separator"), &NDContext::render_separator);
+    rfmap.emplace(std::string("Footer"), &NDContext::render_footer);
+    rfmap.emplace(std::string("SameLine"), &NDContext::render_same_line);
+    rfmap.emplace(std::string("DatePicker"), &NDContext::render_date_picker);
+    rfmap.emplace(std::string("Text"), &NDContext::render_text);
+    rfmap.emplace(std::string("Button"), &NDContext::render_button);
+    rfmap.emplace(std::string("DuckTableSummaryModal"), &NDContext::render_duck_table_summary_modal);
+    rfmap.emplace(std::string("DuckParquetLoadingModal"), &NDContext::render_duck_parquet_loading_modal);
+    rfmap.emplace(std::string("Table"), &NDContext::render_table);
+    rfmap.emplace(std::string("PushFont"), &NDContext::push_font);
+    rfmap.emplace(std::string("PopFont"), &NDContext::pop_font);
 
     // layout is a list of widgets; and all may have children
     // however, not all widgets are children. For instance modals
     // like parquet_loading_modal have to be explicitly pushed
     // on to the render stack by an event. JOS 2025-01-31
     // Fonts appear in layout now. JOS 2025-07-29
+    // We compile the whole layout into nodes once here, so render
+    // does no JSON lookups on cspec.
+    std::vector<NDNodeId> top_level;
     for (nlohmann::json::iterator it = layout.begin(); it != layout.end(); ++it) {
         std::cout << "NDcontext.ctor: layout: " << *it << std::endl;
+        NDNodeId id = compile_widget(*it);
+        top_level.push_back(id);
         std::string widget_id = it->value("widget_id", "");
         if (!widget_id.empty()) {
             std::cout << "NDcontext.ctor: pushable: " << widget_id << ":" << *it << std::endl;
-            pushable[widget_id] = *it;
-        }
-    }
-
-    rfmap.emplace(std::string("Home"), [this](nlohmann::json& w){ render_home(w); });
-    rfmap.emplace(std::string("InputInt"), [this](nlohmann::json& w) { render_input_int(w); });
-    rfmap.emplace(std::string("Combo"), [this](nlohmann::json& w) { render_combo(w); });
-    rfmap.emplace(std::string("Separator"), [this](nlohmann::json& w) { render_separator(w); });
-    rfmap.emplace(std::string("Footer"), [this](nlohmann::json& w) { render_footer(w); });
-    rfmap.emplace(std::string("SameLine"), [this](nlohmann::json& w) { render_same_line(w); });
-    rfmap.emplace(std::string("DatePicker"), [this](nlohmann::json& w) { render_date_picker(w); });
-    rfmap.emplace(std::string("Text"), [this](nlohmann::json& w) { render_text(w); });
-    rfmap.emplace(std::string("Button"), [this](nlohmann::json& w) { render_button(w); });
-    rfmap.emplace(std::string("DuckTableSummaryModal"), [this](nlohmann::json& w) { render_duck_table_summary_modal(w); });
-    rfmap.emplace(std::string("DuckParquetLoadingModal"), [this](nlohmann::json& w) { render_duck_parquet_loading_modal(w); });
-    rfmap.emplace(std::string("Table"), [this](nlohmann::json& w) { render_table(w); });
-    rfmap.emplace(std::string("PushFont"), [this](nlohmann::json& w) { push_font(w); });
-    rfmap.emplace(std::string("PopFont"), [this](nlohmann::json& w) { pop_font(w); });
+            pushable[widget_id] = id;
+        }
+    }
+    std::cout << "NDcontext.ctor: compiled " << nodes.size() << " nodes" << std::endl;
+#ifdef ND_PROFILER
+    for (NDNodeId id : top_level) {
+        profile_paths(id, "");
+    }
+#endif
+    // the stack can't be deeper than the node count, so pushes never realloc
+    stack.reserve(nodes.size());
     // Home on the render stack
-    stack.push_back(layout[0]);
+    if (!top_level.empty()) {
+        stack.push_back(top_level[0]);
+    }
+}
+
+
+NDNodeId NDContext::compile_widget(nlohmann::json& w)
+{
+    NDNodeId id = static_cast<NDNodeId>(nodes.size());
+    nodes.emplace_back();
+    compile_node(id, w);
+    if (w.contains("children")) {
+        compile_children(id, w["children"]);
+    }
+    return id;
+}
+
+
+void NDContext::compile_children(NDNodeId parent, nlohmann::json& children)
+{
+    // siblings are laid out contiguously so the parent can hold
+    // them as an index range; grandchildren follow after
+    NDNodeId begin = static_cast<NDNodeId>(nodes.size());
+    nodes.resize(nodes.size() + children.size());
+    nodes[parent].child_begin = begin;
+    nodes[parent].child_end = begin + static_cast<NDNodeId>(children.size());
+    for (std::size_t i = 0; i < children.size(); i++) {
+        compile_node(begin + static_cast<NDNodeId>(i), children[i]);
+    }
+    for (std::size_t i = 0; i < children.size(); i++) {
+        if (children[i].contains("children")) {
+            compile_children(begin + static_cast<NDNodeId>(i), children[i]["children"]);
+        }
+    }
+}
+
+
+void NDContext::compile_node(NDNodeId id, nlohmann::json& w)
+{
+    const static char* method = "NDContext::compile_node: ";
+    // NB don't hold an NDNode& across compile_children as nodes may realloc
+    NDNode& n(nodes[id]);
+    n.spec = &w;
+    if (!w.contains("rname")) {
+        std::cerr << method << "missing rname in " << w << std::endl;
+        return;
+    }
+    const std::string& rname(w["rname"]);
+    n.rname = intern(rname)->c_str();
+    auto it = rfmap.find(rname);
+    if (it == rfmap.end()) {
+        std::cerr << method << "unknown rname in " << w << std::endl;
+    }
+    else {
+        n.render = it->second;
+    }
+    nlohmann::json cspec = w.value(cspec_cs, nlohmann::json::object());
+    std::string cname = cspec.value(cname_cs, "");
+    n.cname = intern(cname);
+    n.index = intern(cspec.value("index", ""));
+    // resolve cache keys to slots once; a key missing from data
+    // gets a null slot that a later DataChange can fill
+    if (!n.cname->empty()) {
+        if (!data.contains(*n.cname)) {
+            std::cerr << method << "cname(" << *n.cname << ") not in data" << std::endl;
+        }
+        n.slot = data.slot(*n.cname);
+    }
+    if (!n.index->empty()) {
+        n.index_slot = data.slot(*n.index);
+    }
+    // label, title and text all end up as n.label, with
+    // defaults matching the old per frame cspec lookups
+    std::string label = cspec.value("label", cspec.value(title_cs, cspec.value("text", "")));
+    if (label.empty()) {
+        label = rname == "Home" ? nodom_cs : cname;
+    }
+    n.label = intern(label)->c_str();
+    // a label or title changes what a Button shows, not what it does
+    n.action = intern(cspec.value("text", ""))->c_str();
+    if (rname == "Button" && !n.action[0]) {
+        std::cerr << method << "no text in cspec(" << cspec << ")" << std::endl;
+    }
+    n.step = cspec.value("step", 1);
+    n.step_fast = cspec.value("step_fast", 1);
+    n.flags = cspec.value("flags", 0);
+    if (rname == "DatePicker") {
+        n.flags = cspec.value(table_flags_cs, ImGuiTableFlags_BordersOuter | ImGuiTableFlags_SizingFixedFit |
+            ImGuiTableFlags_NoHostExtendX | ImGuiTableFlags_NoHostExtendY);
+    }
+    else if (rname == "DuckTableSummaryModal") {
+        n.flags = cspec.value(table_flags_cs, ImGuiTableFlags_BordersOuter | ImGuiTableFlags_RowBg);
+    }
+    else if (rname == "Table") {
+        // ScrollY so render_table can clip to the visible rows
+        n.flags = cspec.value(table_flags_cs, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY |
+            ImGuiTableFlags_Sortable | ImGuiTableFlags_SortMulti | ImGuiTableFlags_SortTristate);
+        if (cspec.value("filter", false)) n.options |= ND_TABLE_FILTER;
+        table_views.emplace_back(new NDTableView);
+        n.table = table_views.back().get();
+    }
+    else if (rname == "Combo") {
+        combo_views.emplace_back(new NDComboView);
+        n.combo = combo_views.back().get();
+    }
+    if (cspec.contains(font_cs)) {
+        n.font_name = intern(cspec[font_cs].get<std::string>())->c_str();
+        n.font_size_base = cspec.value(font_size_base_cs, 0.0f);
+    }
+    // Footer options all default to on
+    if (rname == "Footer") {
+        if (cspec.value("db", true)) n.options |= ND_FOOTER_DB;
+        if (cspec.value("fps", true)) n.options |= ND_FOOTER_FPS;
+        if (cspec.value("demo", true)) n.options |= ND_FOOTER_DEMO;
+        if (cspec.value("id_stack", true)) n.options |= ND_FOOTER_ID_STACK;
+        if (cspec.value("memory", true)) n.options |= ND_FOOTER_MEMORY;
+        if (cspec.value("py", true)) n.options |= ND_FOOTER_PY;
+        if (cspec.value("tables", true)) n.options |= ND_FOOTER_TABLES;
+        if (cspec.value("profiler", true)) n.options |= ND_FOOTER_PROFILER;
+    }
+}
+
+
+const std::string* NDContext::intern(const std::string& s)
+{
+    // unordered_set nodes don't move on rehash, so these
+    // pointers are good for the life of the context
+    return &*strings.insert(s).first;
+}
+
+
+void NDContext::register_font(const std::string& name, ImFont* f)
+{
+    font_map[name] = f;
+    // bind the font into any compiled nodes that reference it
+    for (auto& n : nodes) {
+        if (n.font_name && name == n.font_name) {
+            n.font = f;
+        }
+    }
 }
 
 
-void NDContext::dispatch_server_responses(std::queue<nlohmann::json>& responses)
+void NDContext::dispatch_server_responses()
 {
     const static char* method = "NDContext::dispatch_server_responses: ";
-    // server_changes will be a list of json obj copied out of a pybind11
-    // list of py dicts. So use C++11 auto range...
-    while (!responses.empty()) {
-        nlohmann::json& resp = responses.front();
+    // once per frame: whatever the inbound rate, the stage holds at most
+    // one DataChange per cache_key plus the msgs that can't merge
+    server.pull_server_responses();
+    std::chrono::steady_clock::time_point stamp;
+    while (server.next_server_response(server_resp, stamp)) {
+        nlohmann::json& resp = server_resp;
         std::cout << method << resp << std::endl;
         // polymorphic as types are hidden inside change
         if (resp[nd_type_cs] == data_change_cs) {
-            data[resp[cache_key_cs]] = resp[new_value_cs];
+            data.set(resp[cache_key_cs].get_ref<const std::string&>(), resp[new_value_cs]);
+            request_redraw();
+        }
+        else if (resp[nd_type_cs] == data_patch_cs) {
+            apply_patch(resp);
+            request_redraw();
         }
         else {
             on_duck_event(resp);
         }
-        responses.pop();
+        server.sample_dispatch(stamp);
     }
 }
 
 
-void NDContext::get_server_responses(std::queue<nlohmann::json>& responses)
+// "/a~1b/0/c" -> head "a/b", rest "/0/c"
+static bool nd_pointer_head(const std::string& path, std::string& head, std::string& rest)
 {
-    server.get_server_responses(responses);
+    if (path.empty() || path[0] != '/') return false;
+    std::size_t end = path.find('/', 1);
+    if (end == std::string::npos) end = path.size();
+    head.clear();
+    for (std::size_t i = 1; i < end; i++) {
+        if (path[i] == '~' && i + 1 < end) {
+            head += path[i + 1] == '1' ? '/' : '~';
+            i++;
+        }
+        else {
+            head += path[i];
+        }
+    }
+    rest = path.substr(end);
+    return true;
+}
+
+
+void NDContext::apply_patch(nlohmann::json& msg)
+{
+    const static char* method = "NDContext::apply_patch: ";
+    if (!msg.contains(patch_cs) || !msg[patch_cs].is_array()) {
+        std::cerr << method << "no patch array in " << msg << std::endl;
+        patch_stats.failures++;
+        return;
+    }
+    nlohmann::json& patch(msg[patch_cs]);
+    auto start = std::chrono::steady_clock::now();
+    try {
+        if (msg.contains(cache_key_cs)) {
+            // paths are rooted at the cache_key's value
+            data.patch(data.slot(msg[cache_key_cs].get_ref<const std::string&>()), patch);
+        }
+        else {
+            // paths are rooted at the cache. Each op goes to the slot named
+            // by its first path token, so only the slots a patch touches
+            // get a version bump, and only their widgets rebuild.
+            std::string head, rest, from_head, from_rest;
+            std::vector<NDSlot> op_slots;
+            for (auto& op : patch) {
+                if (!nd_pointer_head(op.value(path_cs, ""), head, rest)) {
+                    throw std::invalid_argument("op path must name a cache key");
+                }
+                op[path_cs] = rest;
+                if (op.contains(from_cs)) {
+                    if (!nd_pointer_head(op[from_cs].get<std::string>(), from_head, from_rest) || from_head != head) {
+                        throw std::invalid_argument("move|copy across cache keys");
+                    }
+                    op[from_cs] = from_rest;
+                }
+                op_slots.push_back(data.slot(head));
+            }
+            // all or nothing across slots: ops apply to a copy of each
+            // touched slot, and the copies go in once every op has applied
+            std::vector<std::pair<NDSlot, nlohmann::json>> staged;
+            for (std::size_t i = 0; i < patch.size(); i++) {
+                auto it = std::find_if(staged.begin(), staged.end(),
+                            [&](const std::pair<NDSlot, nlohmann::json>& sv) { return sv.first == op_slots[i]; });
+                if (it == staged.end()) {
+                    staged.emplace_back(op_slots[i], data.get(op_slots[i]));
+                    it = staged.end() - 1;
+                }
+                nlohmann::json& op(patch[i]);
+                if (op[path_cs].get_ref<const std::string&>().empty() && op.value(op_cs, "") == "remove") {
+                    // removing a whole cache value
+                    it->second = nlohmann::json();
+                    continue;
+                }
+                it->second.patch_inplace(nlohmann::json::array({ op }));
+            }
+            for (auto& sv : staged) {
+                data.set(sv.first, std::move(sv.second));
+            }
+        }
+    }
+    catch (std::exception& ex) {
+        // nothing was applied, so the cache holds its last good values.
+        // The server isn't told: they stay stale until its next
+        // DataChange for the key.
+        std::cerr << method << ex.what() << " in " << msg << std::endl;
+        patch_stats.failures++;
+        return;
+    }
+    patch_stats.patches++;
+    patch_stats.ops += patch.size();
+    patch_stats.apply_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
 }
 
 
@@ -397,6 +1205,7 @@ void NDContext::on_duck_event(nlohmann::json& duck_msg)
         std::cerr << "NDContext::on_duck_event: no nd_type in " << duck_msg << std::endl;
     }
     std::cout << method << duck_msg << std::endl;
+    request_redraw();
     const std::string& nd_type(duck_msg[nd_type_cs]);
     if (nd_type == "ParquetScan") {
         db_status_color = amber;
@@ -408,14 +1217,49 @@ void NDContext::on_duck_event(nlohmann::json& duck_msg)
         db_status_color = green;
         action_dispatch(duck_msg["query_id"], nd_type);
     }
-    else if (nd_type == "QueryResult") {
+    else if (nd_type == query_result_batch_cs) {
+        // results stream in as record batches: the first batch replaces
+        // any previous result for this query_id, later ones append
+        const std::string& qid(duck_msg[query_id_cs]);
+        std::shared_ptr<arrow::RecordBatch> batch(server.take_batch(duck_msg[batch_cs]));
+        if (!batch) {
+            std::cerr << method << "no staged batch for " << duck_msg << std::endl;
+            return;
+        }
+        if (superseded(qid)) return;
+        NDResult& result(open_result(qid));
+        if (!result.schema) result.schema = batch->schema();
+        result.offsets.push_back(result.num_rows);
+        result.num_rows += batch->num_rows();
+        result.batches.push_back(batch);
+        if (result.batches.size() == 1) {
+            result.first_row = std::chrono::steady_clock::now();
+            std::cout << method << qid << ": first row after "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(result.first_row - result.dispatched).count()
+                << "ms" << std::endl;
+        }
+    }
+    else if (nd_type == query_result_end_cs) {
         db_status_color = green;
-        const std::string& nd_type(duck_msg[nd_type_cs]);
         const std::string& qid(duck_msg[query_id_cs]);
-        std::uint64_t arrow_ptr_val(duck_msg["result"]);
-        std::string cname(qid);
-        cname += "_result";
-        data[cname] = arrow_ptr_val;
+        if (duck_msg.contains(error_cs)) {
+            std::cerr << method << qid << ": " << duck_msg[error_cs] << std::endl;
+            db_status_color = red;
+        }
+        if (superseded(qid)) {
+            // duck_dispatch closed its result when it was re-dispatched
+            query_dispatched[qid].pop_front();
+            return;
+        }
+        // empty results have no batches, so may not be open yet
+        NDResult& result(open_result(qid));
+        result.complete = true;
+        result.completed = std::chrono::steady_clock::now();
+        streaming.erase(qid);
+        query_dispatched.erase(qid);
+        std::cout << method << qid << ": " << result.num_rows << " rows complete after "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(result.completed - result.dispatched).count()
+            << "ms" << std::endl;
     }
     else if (nd_type == "DuckInstance") {
         // TODO: q processing order means this doesn't happen so early in cpp
@@ -431,60 +1275,294 @@ void NDContext::on_duck_event(nlohmann::json& duck_msg)
     }
 }
 
+NDResult& NDContext::open_result(const std::string& qid)
+{
+    auto sit = streaming.find(qid);
+    if (sit != streaming.end()) {
+        return *results[sit->second];
+    }
+    // new result: the cache holds only its handle, so widgets see a
+    // new handle and the previous result for qid is released
+    std::string cname(qid);
+    cname += "_result";
+    NDSlot slot = data.slot(cname);
+    if (data.get(slot).is_number_unsigned()) {
+        results.erase(data.get(slot).get<std::uint64_t>());
+    }
+    std::shared_ptr<NDResult> result(std::make_shared<NDResult>());
+    result->query_id = qid;
+    result->handle = next_result_handle++;
+    auto dit = query_dispatched.find(qid);
+    result->dispatched = dit != query_dispatched.end() ? dit->second.back() : std::chrono::steady_clock::now();
+    results[result->handle] = result;
+    streaming[qid] = result->handle;
+    data.set(slot, result->handle);
+    return *result;
+}
+
+
+// true if msgs for qid belong to a request since re-dispatched
+bool NDContext::superseded(const std::string& qid)
+{
+    auto dit = query_dispatched.find(qid);
+    return dit != query_dispatched.end() && dit->second.size() > 1;
+}
+
+
+std::shared_ptr<NDResult> NDContext::get_result(const std::string& cname)
+{
+    return get_result(data.find(cname));
+}
+
+
+std::shared_ptr<NDResult> NDContext::get_result(NDSlot slot)
+{
+    if (slot == ND_NO_SLOT || !data.get(slot).is_number_unsigned()) return nullptr;
+    auto it = results.find(data.get(slot).get<std::uint64_t>());
+    if (it == results.end()) return nullptr;
+    return it->second;
+}
+
+
+bool NDContext::needs_frame()
+{
+    // an idle UI doesn't render, so flush coalesced DataChanges
+    // that have waited long enough here too
+    server.flush_notifications(false);
+    return redraw_frames > 0 || animating;
+}
+
+
+// upper bounds of the frame time histogram buckets; the last bucket is open
+static const float nd_frame_hist_ms[ND_FRAME_HIST_BUCKETS - 1] = { 4.0f, 8.0f, 12.0f, 16.7f, 20.0f, 25.0f, 33.3f, 50.0f, 100.0f };
+static const char* nd_frame_hist_label = "frame ms: <4 <8 <12 <16.7 <20 <25 <33.3 <50 <100 >=100";
+
+
+void NDContext::set_ws_status(const NDWSStatus& status)
+{
+    // connection state drives the DB button: red while down, amber while
+    // connecting. Once open, duck events take over as before.
+    if (status.state != ws_status.state) {
+        if (status.state == ND_WS_OPEN) db_status_color = green;
+        else if (status.state == ND_WS_CONNECTING) db_status_color = amber;
+        else db_status_color = red;
+    }
+    ws_status = status;
+    request_redraw();
+}
+
+
+void NDContext::record_frame_time(std::int64_t us)
+{
+    const float ms = us / 1000.0f;
+    int bucket = 0;
+    while (bucket < ND_FRAME_HIST_BUCKETS - 1 && ms >= nd_frame_hist_ms[bucket]) bucket++;
+    frame_stats.frame_hist[bucket]++;
+}
+
+
+void NDContext::sample_cpu()
+{
+    // process CPU time over wall time, sampled every ND_CPU_SAMPLE_MS.
+    // Idle stretches where we don't render land in the next sample.
+    auto now = std::chrono::steady_clock::now();
+    auto wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - cpu_sample_wall).count();
+    if (wall_ms < ND_CPU_SAMPLE_MS) return;
+    boost::chrono::process_cpu_clock::times t(boost::chrono::process_cpu_clock::now().time_since_epoch().count());
+    std::int64_t cpu_ns = t.user + t.system;
+    if (cpu_sample_ns) {
+        frame_stats.cpu_pct = 100.0 * (cpu_ns - cpu_sample_ns) / (wall_ms * 1000000.0);
+    }
+    cpu_sample_ns = cpu_ns;
+    cpu_sample_wall = now;
+}
+
+
 void NDContext::render()
 {
-    if (pending_pops.size() || pending_pushes.size()) {
-        std::cerr << "render: " << pending_pops.size() << " pending pops, " << pending_pushes.size()
-            << " pending pushes" << std::endl;
-    }
-    // address pending pops first: maintaining ordering by working from front to back
-    // as that is the order they would land on the stack if not pushed during rendering
-    while (!pending_pops.empty()) {
-        pop_widget(pending_pops.front());
-        pending_pops.pop_front();
-    }
-    // drain pending_pushes onto the render stack, maintaining
-    // the stack order we would have had if the push had
-    // happended intra-render. JOS 2025-01-31
-    while (!pending_pushes.empty()) {
-        push_widget(pending_pushes.front());
-        pending_pushes.pop_front();
-    }
-    // This loop breaks if we raise a modal as changing stack state while this
-    // iter is live segfaults. JS lets us get away with that in main.ts:render
-    // Here we push modals into pending_pushes so they can push/pop outside
-    // the context of the loop below. JOS 2025-01-31
-    for (std::deque<nlohmann::json>::iterator it = stack.begin(); it != stack.end(); ++it) {
-        // deref it for clarity and to rename as widget for
-        // cross ref with main.ts logic
-        nlohmann::json& widget = *it;
+#ifdef ND_PROFILER
+    profiler.begin_frame();
+    if (ImGui::IsKeyPressed(ImGuiKey_F9, false)) {
+        std::ostringstream fname;
+        fname << "nd_trace_" << std::time(nullptr) << ".json";
+        profiler.dump_trace(fname.str());
+    }
+#endif
+    frame_stats.frames++;
+    sample_cpu();
+    animating = false;
+    if (redraw_frames > 0) redraw_frames--;
+    // flush coalesced DataChanges that have waited long enough
+    server.flush_notifications(false);
+    // the demo has its own animations
+    if (show_demo_window) {
+        ImGui::ShowDemoWindow(&show_demo_window);
+        request_animation();
+    }
+    // caret blink
+    if (ImGui::GetIO().WantTextInput) request_animation();
+    // The old iterator walk segfaulted if a widget raised a modal mid render,
+    // hence the pending_pushes workaround. JOS 2025-01-31
+    // Now the stack holds node ids and we walk it by index, re-reading size
+    // each pass, so action_dispatch can push and pop in place as main.ts
+    // does. A push lands on the back and renders this frame. Pops only
+    // remove the back, which is at or past the current index. A modal
+    // that pops itself and pushes another leaves the new one at the
+    // current index, so we render that index once more rather than skip
+    // the new one for a frame. Only once, so a chain of such swaps can't
+    // spin within a frame; the rest of the chain waits for the next.
+    bool rerender = false;
+    for (std::size_t i = 0; i < stack.size(); ) {
+        NDNodeId id = stack[i];
+        // rename as widget for cross ref with main.ts logic
+        NDNode& widget = nodes[id];
         dispatch_render(widget);
+        if (!rerender && i < stack.size() && stack[i] != id) {
+            rerender = true;
+            continue;
+        }
+        rerender = false;
+        i++;
     }
+#ifdef ND_PROFILER
+    if (show_profiler) render_profiler();
+    profiler.end_frame();
+#endif
 }
 
 
-void NDContext::dispatch_render(nlohmann::json& w)
+#ifdef ND_PROFILER
+void NDContext::profile_paths(NDNodeId id, const std::string& parent)
 {
-    if (!w.contains("rname")) {
-        std::stringstream error_buf;
-        error_buf << "dispatch_render: missing rname in " << w << "\n";
-        printf(error_buf.str().c_str());
-        return;
+    // eg Home:NoDOM/InputInt:width
+    NDNode& n(nodes[id]);
+    std::string path(parent);
+    if (!path.empty()) path += "/";
+    path += n.rname;
+    if (n.label[0]) {
+        path += ":";
+        path += n.label;
     }
-    const std::string& rname(w["rname"]);
-    auto it = rfmap.find(rname);
-    if (it == rfmap.end()) {
-        std::stringstream error_buf;
-        error_buf << "dispatch_render: unknown rname in " << w << "\n";
-        printf(error_buf.str().c_str());
-        return;
+    profiler.set_key(id, n.rname, path);
+    for (NDNodeId child = n.child_begin; child < n.child_end; ++child) {
+        profile_paths(child, path);
     }
-    it->second(w);
 }
 
-void NDContext::duck_dispatch(const std::string& nd_type, const std::string& sql, const std::string& qid)
+
+void NDContext::render_profiler()
+{
+    // rows are node or rname indices into the profiler, sorted per
+    // the table's specs each frame: the row counts are small
+    const bool by_rname = profile_by_rname;
+    const std::size_t row_count = by_rname ? profiler.rname_count() : profiler.node_count();
+    auto stats = [this, by_rname](std::uint32_t i) -> const NDProfileStats& {
+        return by_rname ? profiler.get_rname_stats(i) : profiler.get_node_stats(i);
+    };
+    auto mean_us = [](const NDProfileStats& s) -> double {
+        return s.calls ? s.total_ns / 1000.0 / s.calls : 0.0;
+    };
+
+    ImGui::Begin("Profiler", &show_profiler);
+    if (ImGui::RadioButton("by widget", !profile_by_rname)) profile_by_rname = false;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("by rname", profile_by_rname)) profile_by_rname = true;
+    ImGui::SameLine();
+    ImGui::TextUnformatted("F9: dump trace");
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable |
+        ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+    if (ImGui::BeginTable("profiler_table", 5, flags)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn(by_rname ? "rname" : "widget", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("calls");
+        ImGui::TableSetupColumn("mean us", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn("p99 us", ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn("max us", ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableHeadersRow();
+
+        profile_rows.clear();
+        for (std::uint32_t i = 0; i < row_count; i++) {
+            if (stats(i).calls) profile_rows.push_back(i);
+        }
+        ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs();
+        if (specs && specs->SpecsCount) {
+            const ImGuiTableColumnSortSpecs& spec(specs->Specs[0]);
+            const bool ascending = spec.SortDirection != ImGuiSortDirection_Descending;
+            // p99 is a nth_element per row, so resolve it once up front
+            std::vector<std::int64_t> p99s;
+            if (spec.ColumnIndex == 3) {
+                p99s.resize(row_count);
+                for (std::uint32_t i : profile_rows) p99s[i] = profiler.p99(stats(i));
+            }
+            std::sort(profile_rows.begin(), profile_rows.end(), [&](std::uint32_t a, std::uint32_t b) {
+                const NDProfileStats& sa(stats(a));
+                const NDProfileStats& sb(stats(b));
+                int cmp = 0;
+                switch (spec.ColumnIndex) {
+                case 0: cmp = by_rname ? strcmp(profiler.rname_name(a), profiler.rname_name(b))
+                                       : profiler.node_path(a).compare(profiler.node_path(b)); break;
+                case 1: cmp = sa.calls < sb.calls ? -1 : sa.calls > sb.calls; break;
+                case 2: cmp = mean_us(sa) < mean_us(sb) ? -1 : mean_us(sa) > mean_us(sb); break;
+                case 3: cmp = p99s[a] < p99s[b] ? -1 : p99s[a] > p99s[b]; break;
+                case 4: cmp = sa.max_ns < sb.max_ns ? -1 : sa.max_ns > sb.max_ns; break;
+                }
+                return ascending ? cmp < 0 : cmp > 0;
+            });
+            specs->SpecsDirty = false;
+        }
+        for (std::uint32_t i : profile_rows) {
+            const NDProfileStats& s(stats(i));
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(by_rname ? profiler.rname_name(i) : profiler.node_path(i).c_str());
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%llu", static_cast<unsigned long long>(s.calls));
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.1f", mean_us(s));
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%.1f", profiler.p99(s) / 1000.0);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%.1f", s.max_ns / 1000.0);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+#endif
+
+
+void NDContext::dispatch_render(NDNode& n)
+{
+    // compiled out unless ND_PROFILER
+    ND_PROFILE_SCOPE(profiler, static_cast<std::uint32_t>(&n - nodes.data()));
+    // unknown or missing rnames were reported by compile_node
+    if (n.render) {
+        (this->*n.render)(n);
+    }
+}
+
+void NDContext::duck_dispatch(const std::string& nd_type, const std::string& sql, const std::string& qid,
+                                const std::string& lane_key)
 {
     nlohmann::json duck_request = { {nd_type_cs, nd_type}, {sql_cs, sql}, {query_id_cs, qid} };
+    if (!lane_key.empty()) duck_request[lane_key_cs] = lane_key;
+    // start of the clock for time to first row
+    std::chrono::steady_clock::time_point now(std::chrono::steady_clock::now());
+    // a re-dispatch replaces any request still in flight for qid: close
+    // its result now, and drop the rest of its msgs as they arrive. A
+    // query_id's requests come from one db_op, so share a lane and end
+    // in dispatch order.
+    auto sit = streaming.find(qid);
+    if (sit != streaming.end()) {
+        auto rit = results.find(sit->second);
+        if (rit != results.end()) {
+            rit->second->complete = true;
+            rit->second->completed = now;
+        }
+        streaming.erase(sit);
+    }
+    query_dispatched[qid].push_back(now);
     server.duck_dispatch(duck_request);
 }
 
@@ -503,7 +1581,7 @@ void NDContext::action_dispatch(const std::string& action, const std::string& nd
     auto it = pushable.find(action);
     if (it != pushable.end() && nd_event.empty()) {
         std::cout << "cpp: action_dispatch: pushable(" << action << ")" << std::endl;
-        stack.push_back(pushable[action]);
+        push_widget(it->second);
     }
     else {
         if (!data.contains("actions")) {
@@ -543,7 +1621,7 @@ void NDContext::action_dispatch(const std::string& action, const std::string& nd
             // the context can check the widget type on pops
             const std::string& rname(action_defn["ui_pop"]);
             std::cout << "cpp: action_dispatch: ui_pop(" << rname << ")" << std::endl;
-            pending_pops.push_back(rname);
+            pop_widget(rname);
         }
         if (action_defn.contains("ui_push")) {
             // for pushes we supply widget_id, not the rname
@@ -553,8 +1631,8 @@ void NDContext::action_dispatch(const std::string& action, const std::string& nd
             if (push_it != pushable.end()) {
                 std::cout << "cpp: action_dispatch: ui_push(" << widget_id << ")" << std::endl;
                 // NB action_dispatch is called by eg render_button, which ultimately is called
-                // by render(), which iterates over stack. So we cannot change stack here...
-                pending_pushes.push_back(push_it->second);
+                // by render(), which iterates over stack. That's safe: see render
+                push_widget(push_it->second);
             }
             else {
                 std::cerr << "cpp: action_dispatch: ui_push(" << widget_id << ") no such pushable" << std::endl;
@@ -572,8 +1650,8 @@ void NDContext::action_dispatch(const std::string& action, const std::string& nd
                     std::cerr << "cpp: action_dispatch: db(" << db_op << ") sql_cname(" << sql_cache_key << ") does not resolve" << std::endl;
                 }
                 else {
-                    const std::string& sql(data[sql_cache_key]);
-                    duck_dispatch(db_op["action"], sql, db_op["query_id"]);
+                    const std::string& sql(data[sql_cache_key].get_ref<const std::string&>());
+                    duck_dispatch(db_op["action"], sql, db_op["query_id"], db_op.value(lane_key_cs, ""));
                 }
             }
         }
@@ -581,37 +1659,16 @@ void NDContext::action_dispatch(const std::string& action, const std::string& nd
 }
 
 
-void NDContext::render_home(nlohmann::json& w)
+void NDContext::render_home(NDNode& n)
 {
-    if (!w.contains("cspec")) {
-        std::cerr << "render_home: no cspec in w(" << w << ")" << std::endl;
-        return;
+    bool pop_font = false;
+    if (n.font) {
+        ImGui::PushFont(n.font, n.font_size_base);
+        pop_font = true;
     }
-    nlohmann::json& cspec = w["cspec"];
-    std::string title(nodom_cs);
-    if (cspec.contains("title")) {
-        title = cspec["title"];
-    }
-    boolean pop_font = false;
-    float font_size_base = 0.0;
-    if (cspec.contains("font")) {
-        std::string font_name = cspec["font"];
-        auto font_it = font_map.find(font_name);
-        if (font_it != font_map.end()) {
-            if (cspec.contains(font_size_base_cs)) {
-                font_size_base = cspec[font_size_base_cs];
-            }
-            ImGui::PushFont(font_it->second, font_size_base);
-            pop_font = true;
-        }
-        else {
-            std::cerr << "render_home: bad font cspec in w(" << w << ")" << std::endl;
-        }
-    }
-    ImGui::Begin(title.c_str());
-    nlohmann::json& children = w["children"];
-    for (nlohmann::json::iterator it = children.begin(); it != children.end(); ++it) {
-        dispatch_render(*it);
+    ImGui::Begin(n.label);
+    for (NDNodeId child = n.child_begin; child < n.child_end; ++child) {
+        dispatch_render(nodes[child]);
     }
     if (pop_font) {
         ImGui::PopFont();
@@ -620,136 +1677,269 @@ void NDContext::render_home(nlohmann::json& w)
 }
 
 
-void NDContext::render_input_int(nlohmann::json& w)
+void NDContext::render_input_int(NDNode& n)
 {
     // static storage: imgui wants int (int32), nlohmann::json uses int64_t
     static int input_integer;
-    input_integer = 0;
-    // params by value
-    int step = w.value(nlohmann::json::json_pointer("/cspec/step"), 1);
-    int step_fast = w.value(nlohmann::json::json_pointer("/cspec/step_fast"), 1);
-    int flags = w.value(nlohmann::json::json_pointer("/cspec/flags"), 0);
+    // step, step_fast, flags and label are bound at compile time;
     // one param by ref: the int itself
-    std::string cname_cache_addr = w.value(nlohmann::json::json_pointer("/cspec/cname"), "render_input_int_bad_cname");
-    // label is a layout value
-    std::string label = w.value(nlohmann::json::json_pointer("/cspec/label"), "");
-    // if no label use cache addr
-    if (!label.size()) label = cname_cache_addr;
+    // null until a DataChange fills the slot, and json won't make an int of null
+    if (n.slot == ND_NO_SLOT || !data.get(n.slot).is_number()) return;
     // local static copy of cache val
-    int old_val = input_integer = data[cname_cache_addr];
+    int old_val = input_integer = data.get(n.slot);
     // imgui has ptr to copy of cache val
-    ImGui::InputInt(label.c_str(), &input_integer, step, step_fast, flags);
+    ImGui::InputInt(n.label, &input_integer, n.step, n.step_fast, n.flags);
     // copy local copy back into cache
     if (input_integer != old_val) {
-        data[cname_cache_addr] = input_integer;
-        notify_server(cname_cache_addr, nlohmann::json(old_val), nlohmann::json(input_integer));
+        data.set(n.slot, input_integer);
+        notify_server(*n.cname, nlohmann::json(old_val), nlohmann::json(input_integer));
+    }
+}
+
+
+// case insensitive compares for the combo prefix index
+static int nd_strcasecmp(const char* a, const char* b)
+{
+    for (;; a++, b++) {
+        int ca = tolower(static_cast<unsigned char>(*a));
+        int cb = tolower(static_cast<unsigned char>(*b));
+        if (ca != cb || !ca) return ca - cb;
+    }
+}
+
+static int nd_strncasecmp(const char* a, const char* b, std::size_t n)
+{
+    for (; n; a++, b++, n--) {
+        int ca = tolower(static_cast<unsigned char>(*a));
+        int cb = tolower(static_cast<unsigned char>(*b));
+        if (ca != cb || !ca) return ca - cb;
+    }
+    return 0;
+}
+
+
+void NDContext::build_combo_items(NDComboView& view, const nlohmann::json& list)
+{
+    const static char* method = "NDContext::build_combo_items: ";
+    view.items.clear();
+    view.sorted.clear();
+    // item ids are list positions, as they go back to the server as the
+    // selection index, so a non string item holds its position with an
+    // empty label. It's left out of sorted, so no filter matches it.
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        if (!it->is_string()) {
+            std::cerr << method << "non string item: " << *it << std::endl;
+            view.items.push_back("");
+            continue;
+        }
+        view.sorted.push_back(static_cast<std::uint32_t>(view.items.size()));
+        view.items.push_back(it->get_ref<const std::string&>().c_str());
     }
+    const std::vector<const char*>& items(view.items);
+    std::stable_sort(view.sorted.begin(), view.sorted.end(), [&items](std::uint32_t a, std::uint32_t b) {
+        return nd_strcasecmp(items[a], items[b]) < 0;
+    });
+    filter_combo_items(view);
+}
+
+
+void NDContext::filter_combo_items(NDComboView& view)
+{
+    const std::vector<const char*>& items(view.items);
+    const char* prefix = view.filter;
+    const std::size_t len = strlen(prefix);
+    // items matching prefix are contiguous in sorted
+    auto begin = std::lower_bound(view.sorted.begin(), view.sorted.end(), prefix,
+        [&items, len](std::uint32_t id, const char* p) { return nd_strncasecmp(items[id], p, len) < 0; });
+    auto end = std::upper_bound(begin, view.sorted.end(), prefix,
+        [&items, len](const char* p, std::uint32_t id) { return nd_strncasecmp(p, items[id], len) < 0; });
+    view.match_begin = begin - view.sorted.begin();
+    view.match_end = end - view.sorted.begin();
 }
 
 
-void NDContext::render_combo(nlohmann::json& w)
+void NDContext::render_combo(NDNode& n)
 {
-    // Static storage for the combo list
-    // NB single GUI thread!
-    // No malloc at runbtime, but we will clear the array with a memset
-    // on each visit. JOS 2025-01-26
-    static std::vector<std::string> combo_list;
-    static const char* cs_combo_list[ND_MAX_COMBO_LIST];
-    static int combo_selection;
-    memset(cs_combo_list, 0, ND_MAX_COMBO_LIST * sizeof(char*));
-    combo_selection = 0;
-    combo_list.clear();
     // no value params in layout here; all combo layout is data cache refs
-    // /cspec/cname should give us a data cache addr for the combo list
-    std::string combo_list_cache_addr = w.value(nlohmann::json::json_pointer("/cspec/cname"), "render_combo_list_bad_cname");
-    std::string combo_index_cache_addr = w.value(nlohmann::json::json_pointer("/cspec/index"), "render_combo_list_bad_index");
-    std::string label = w.value(nlohmann::json::json_pointer("/cspec/label"), "");
-    // if no label use cache addr
-    if (!label.size()) label = combo_list_cache_addr;
-    int combo_count = 0;
-    combo_list = data[combo_list_cache_addr];
-    for (auto it = combo_list.begin(); it != combo_list.end(); ++it) {
-        cs_combo_list[combo_count++] = it->c_str();
-        if (combo_count == ND_MAX_COMBO_LIST) break;
+    // cname gives us a data cache addr for the combo list, index for the selection
+    if (n.slot == ND_NO_SLOT || n.index_slot == ND_NO_SLOT) return;
+    NDComboView& view(*n.combo);
+    if (view.version != data.version(n.slot)) {
+        build_combo_items(view, data.get(n.slot));
+        view.version = data.version(n.slot);
+    }
+    const nlohmann::json& index_j = data.get(n.index_slot);
+    const int old_val = index_j.is_number() ? index_j.get<int>() : -1;
+    const int item_count = static_cast<int>(view.items.size());
+    int selection = old_val;
+    const char* preview = old_val >= 0 && old_val < item_count ? view.items[old_val] : "";
+
+    if (ImGui::BeginCombo(n.label, preview, ImGuiComboFlags_HeightLargest)) {
+        const bool appearing = ImGui::IsWindowAppearing();
+        if (appearing) {
+            view.filter[0] = 0;
+            filter_combo_items(view);
+            ImGui::SetKeyboardFocusHere();
+        }
+        if (ImGui::InputTextWithHint("##filter", "type to filter", view.filter, ND_FILTER_BUF_SZ)) {
+            filter_combo_items(view);
+        }
+        // unfiltered we show list order, filtered the matches in prefix index order
+        const bool filtering = view.filter[0] != 0;
+        const int count = filtering ? static_cast<int>(view.match_end - view.match_begin) : item_count;
+        if (filtering && count && ImGui::IsKeyPressed(ImGuiKey_Enter)) {
+            selection = static_cast<int>(view.sorted[view.match_begin]);
+            ImGui::CloseCurrentPopup();
+        }
+        const float height = ImGui::GetTextLineHeightWithSpacing() * std::max(1, std::min(count, ND_COMBO_VISIBLE_ITEMS));
+        if (ImGui::BeginChild("##items", ImVec2(0.0f, height))) {
+            ImGuiListClipper clipper;
+            clipper.Begin(count);
+            // make sure the current selection is laid out so we can scroll to it
+            if (appearing && !filtering && old_val >= 0 && old_val < item_count) {
+                clipper.IncludeItemByIndex(old_val);
+            }
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                    const int id = filtering ? static_cast<int>(view.sorted[view.match_begin + i]) : i;
+                    const bool selected = id == old_val;
+                    ImGui::PushID(id);
+                    if (ImGui::Selectable(view.items[id], selected)) {
+                        selection = id;
+                        ImGui::CloseCurrentPopup();
+                    }
+                    if (selected && appearing) {
+                        ImGui::SetScrollHereY();
+                    }
+                    ImGui::PopID();
+                }
+            }
+        }
+        ImGui::EndChild();
+        ImGui::EndCombo();
     }
-    int old_val = combo_selection = data[combo_index_cache_addr];
-    ImGui::Combo(label.c_str(), &combo_selection, cs_combo_list, combo_count, combo_count);
-    if (combo_selection != old_val) {
-        data[combo_index_cache_addr] = combo_selection;
-        notify_server(combo_index_cache_addr, nlohmann::json(old_val), nlohmann::json(combo_selection));
+    if (selection != old_val) {
+        data.set(n.index_slot, selection);
+        notify_server(*n.index, nlohmann::json(old_val), nlohmann::json(selection));
     }
 }
 
 
-void NDContext::render_separator(nlohmann::json& w)
+void NDContext::render_separator(NDNode& n)
 {
     ImGui::Separator();
 }
 
 
-void NDContext::render_footer(nlohmann::json& w)
+void NDContext::render_footer(NDNode& n)
 {
-    // TODO: optimise local vars: these cspec are not cache refs so could
-    // bound at startup time...
-    bool db = w.value(nlohmann::json::json_pointer("/cspec/db"), true);
-    bool fps = w.value(nlohmann::json::json_pointer("/cspec/fps"), true);
-    bool demo = w.value(nlohmann::json::json_pointer("/cspec/demo"), true);
-    bool id_stack = w.value(nlohmann::json::json_pointer("/cspec/id_stack"), true);
-    bool memory = w.value(nlohmann::json::json_pointer("/cspec/memory"), true);
-
-    if (db) {
+    // cspec options are bound to n.options at compile time
+    if (n.options & ND_FOOTER_DB) {
         // Push colour styling for the DB button
         ImGui::PushStyleColor(ImGuiCol_Button, (ImU32)db_status_color);
         if (ImGui::Button("DB")) {
             // TODO: main.ts raises a new brwser tab here...
         }
         ImGui::PopStyleColor(1);
+        if (ImGui::IsItemHovered() && duck_app()) {
+            static const char* ws_state_names[] = { "disconnected", "connecting", "open" };
+            ImGui::SetTooltip("websock %s, %s\nconnects %llu of %llu attempts\nqueued %zu, dropped %llu\nping rtt %lldus\n"
+                "in %llu msgs, %llu bytes, decode %lldus\nout %llu bytes\narrow ipc %llu frames, %llu rows",
+                ws_state_names[ws_status.state], nd_encoding_names[ws_status.encoding], ws_status.connects,
+                ws_status.connect_attempts, ws_status.queued, ws_status.dropped, ws_status.rtt_us,
+                ws_status.msgs_in, ws_status.bytes_in, ws_status.decode_us, ws_status.bytes_out,
+                ws_status.ipc_frames, ws_status.ipc_rows);
+        }
     }
-    if (fps) {
+    if (n.options & ND_FOOTER_FPS) {
         ImGui::SameLine();
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        ImGui::Text("cpu %.1f%%, frames %llu, idle waits %llu, target fps %d, skipped %llu", frame_stats.cpu_pct,
+            frame_stats.frames, frame_stats.idle_waits, frame_stats.target_fps, frame_stats.skipped);
+        float hist[ND_FRAME_HIST_BUCKETS];
+        for (int i = 0; i < ND_FRAME_HIST_BUCKETS; i++) hist[i] = static_cast<float>(frame_stats.frame_hist[i]);
+        ImGui::Text("websock msgs %llu, backlog max %zu, full waits %llu",
+            frame_stats.ws_messages, frame_stats.ws_backlog_max, frame_stats.ws_full_waits);
+        // compressed size as a percentage of raw, and CPU time spent on it
+        const NDDeflateStats& ds(ws_status.deflate);
+        ImGui::Text("deflate out %.1f%% of %llu bytes in %lldus, %llu bytes under threshold; inflate in %.1f%% of %llu bytes in %lldus",
+            ds.out_raw ? 100.0 * ds.out_wire / ds.out_raw : 0.0, ds.out_raw, ds.deflate_us, ds.out_plain,
+            ds.in_raw ? 100.0 * ds.in_wire / ds.in_raw : 0.0, ds.in_raw, ds.inflate_us);
+        ImGui::PlotHistogram("##frame_hist", hist, ND_FRAME_HIST_BUCKETS, 0, nd_frame_hist_label, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
     }
-    /* TODO
-    if (demo) {
-
-    } */
-    if (id_stack) {
+    if (n.options & ND_FOOTER_PY) {
+        NDBatchStats bs(get_batch_stats());
+        ImGui::Text("py batches %llu, msgs %llu, py calls %llu, saved calls %llu",
+            bs.batches, bs.messages, bs.py_calls, bs.messages - bs.py_calls);
+        ImGui::Text("notifications %llu, coalesced %llu, py encoding %s, packed bytes %llu", bs.notifications,
+            bs.coalesced, nd_encoding_names[bs.py_encoding], bs.packed_bytes);
+        NDInboundStats is(get_inbound_stats());
+        ImGui::Text("inbound depth %zu, max %zu, merged %llu, dropped %llu, blocked %llu, barriers %llu, dispatched %llu",
+            is.depth, is.depth_max, is.merged, is.dropped, is.blocked, is.barriers, is.dispatched);
+        ImGui::Text("patches out %llu, saved %llu bytes, diff %lldus; in %llu, %llu ops, %llu failed, apply %lldus",
+            bs.patches, bs.patch_bytes_saved, bs.diff_us, patch_stats.patches, patch_stats.ops, patch_stats.failures,
+            patch_stats.apply_us);
+        // lane_stats is reused frame to frame to avoid a heap alloc
+        get_lane_stats(lane_stats);
+        for (auto& ls : lane_stats) {
+            ImGui::Text("lane %s: depth %zu, batches %llu, msgs %llu, wait %lldus, max wait %lldus, exec %lldus",
+                ls.name.c_str(), ls.depth, ls.batches, ls.messages, ls.last_wait_us, ls.max_wait_us, ls.last_exec_us);
+        }
+        NDLatencyStats ls(get_latency_stats());
+        ImGui::Text("py round trip p50 %lldus, p99 %lldus (%llu samples); to inbound stage p50 %lldus, p99 %lldus",
+            ls.p50_us, ls.p99_us, ls.samples, ls.staged_p50_us, ls.staged_p99_us);
+    }
+    if (n.options & ND_FOOTER_TABLES) {
+        NDTextCacheStats ts;
+        get_text_cache_stats(ts);
+        std::uint64_t lookups = ts.hits + ts.misses;
+        ImGui::Text("table text cache: block hit rate %.1f%%, hits %llu, misses %llu, evictions %llu, cells %llu, blocks %llu",
+            lookups ? 100.0 * ts.hits / lookups : 0.0, ts.hits, ts.misses, ts.evictions, ts.cells, ts.blocks);
+    }
+    if (n.options & ND_FOOTER_DEMO) {
+        ImGui::Checkbox("demo", &show_demo_window);
+    }
+#ifdef ND_PROFILER
+    if (n.options & ND_FOOTER_PROFILER) {
+        ImGui::SameLine();
+        ImGui::Checkbox("profiler", &show_profiler);
+    }
+#endif
+    if (n.options & ND_FOOTER_ID_STACK) {
         ImGui::ShowStackToolWindow();
     }
     /* TODO
-    if (memory) {
+    if (n.options & ND_FOOTER_MEMORY) {
 
     } */
 }
 
 
-void NDContext::render_same_line(nlohmann::json& w)
+void NDContext::render_same_line(NDNode& n)
 {
     ImGui::SameLine();
 }
 
 
-void NDContext::render_date_picker(nlohmann::json& w)
+void NDContext::render_date_picker(NDNode& n)
 {
-    static int default_table_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_SizingFixedFit |
-        ImGuiTableFlags_NoHostExtendX | ImGuiTableFlags_NoHostExtendY;
     static int ymd_i[3] = { 0, 0, 0 };
     static float tsz[2] = { 274.5,301.5 };
     try {
-        int flags = w.value(nlohmann::json::json_pointer("/cspec/table_flags"), default_table_flags);
-        std::string ckey = w.value(nlohmann::json::json_pointer("/cspec/cname"), "render_date_picker_bad_cname");
-        nlohmann::json ymd_old_j = nlohmann::json::array();
-        ymd_old_j = data[ckey];
+        if (n.slot == ND_NO_SLOT) return;
+        const std::string& ckey(*n.cname);
+        const nlohmann::json& ymd_old_j = data.get(n.slot);
         ymd_i[0] = ymd_old_j.at(0);
         ymd_i[1] = ymd_old_j.at(1);
         ymd_i[2] = ymd_old_j.at(2);
-        if (ImGui::DatePicker(ckey.c_str(), ymd_i, tsz, false, flags)) {
+        if (ImGui::DatePicker(ckey.c_str(), ymd_i, tsz, false, n.flags)) {
+            nlohmann::json ymd_old_copy(ymd_old_j);
             nlohmann::json ymd_new_j = nlohmann::json::array();
             ymd_new_j.push_back(ymd_i[0]);
             ymd_new_j.push_back(ymd_i[1]);
             ymd_new_j.push_back(ymd_i[2]);
-            data[ckey] = ymd_new_j;
-            notify_server(ckey, ymd_old_j, ymd_new_j);
+            data.set(n.slot, ymd_new_j);
+            notify_server(ckey, ymd_old_copy, ymd_new_j);
         }
     }
     catch (nlohmann::json::exception& ex) {
@@ -758,52 +1948,41 @@ void NDContext::render_date_picker(nlohmann::json& w)
 }
 
 
-void NDContext::render_text(nlohmann::json& w)
+void NDContext::render_text(NDNode& n)
 {
-    std::string rtext = w.value(nlohmann::json::json_pointer("/cspec/text"), "");
-    ImGui::Text(rtext.c_str());
+    ImGui::TextUnformatted(n.label);
 }
 
 
-void NDContext::render_button(nlohmann::json& w)
+void NDContext::render_button(NDNode& n)
 {
-    if (!w.contains("cspec")) {
-        std::cerr << "render_button: no cspec in w(" << w << ")" << std::endl;
-        return;
-    }
-    nlohmann::json& cspec = w["cspec"];
-    if (!cspec.contains("text")) {
-        std::cerr << "render_button: no text in cspec(" << cspec << ")" << std::endl;
-        return;
-    }
-    const std::string& button_text = cspec["text"];
-    if (ImGui::Button(button_text.c_str())) {
-        action_dispatch(button_text, "Button");
+    if (ImGui::Button(n.label)) {
+        action_dispatch(n.action, "Button");
     }
 }
 
-void NDContext::render_duck_parquet_loading_modal(nlohmann::json& w)
+void NDContext::render_duck_parquet_loading_modal(NDNode& n)
 {
     static ImVec2 position = { 0.5, 0.5 };
-    std::string cname_cache_addr = w.value(nlohmann::json::json_pointer("/cspec/cname"), "");
-    std::string title = w.value(nlohmann::json::json_pointer("/cspec/title"), "");
-    ImGui::OpenPopup(title.c_str());
+    if (n.slot == ND_NO_SLOT) return;
+    ImGui::OpenPopup(n.label);
 
     // Always center this window when appearing
     ImGuiViewport* vp = ImGui::GetMainViewport();
     if (!vp) {
-        std::cerr << "render_duck_parquet_loading_modal: cname: " << cname_cache_addr
-            << ", title: " << title << ", null viewport ptr!";
+        std::cerr << "render_duck_parquet_loading_modal: cname: " << *n.cname
+            << ", title: " << n.label << ", null viewport ptr!";
     }
     auto center = vp->GetCenter();
     ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, position);
 
     // Get the parquet url list
-    auto pq_urls = data[cname_cache_addr];
-    std::cout << "render_duck_parquet_loading_modal: urls: " << pq_urls << std::endl;
+    const nlohmann::json& pq_urls = data.get(n.slot);
 
-    if (ImGui::BeginPopupModal(title.c_str(), nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
-        for (int i = 0; i < pq_urls.size(); i++) ImGui::Text(pq_urls[i].get<std::string>().c_str());
+    if (ImGui::BeginPopupModal(n.label, nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        for (int i = 0; i < pq_urls.size(); i++) ImGui::TextUnformatted(pq_urls[i].get_ref<const std::string&>().c_str());
+        // the spinner animates, so keep frames coming while it's up
+        request_animation();
         if (!ImGui::Spinner("parquet_loading_spinner", 5, 2, 0)) {
             // TODO: spinner always fails IsClippedEx on first render
             std::cerr << "render_duck_parquet_loading_modal: spinner fail" << std::endl;
@@ -813,25 +1992,12 @@ void NDContext::render_duck_parquet_loading_modal(nlohmann::json& w)
 }
 
 
-void NDContext::render_duck_table_summary_modal(nlohmann::json& w)
+void NDContext::render_duck_table_summary_modal(NDNode& n)
 {
     const static char* method = "NDContext::render_duck_table_summary_modal: ";
-    static int default_summary_table_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_RowBg;
+    const std::string& cname(*n.cname);
 
-    if (!w.contains(cspec_cs) || !w[cspec_cs].contains(cname_cs) || !w[cspec_cs].contains(title_cs)) {
-        std::cerr << method << "bad cspec in: " << w << std::endl;
-        return;
-    }
-    const nlohmann::json& cspec(w[cspec_cs]);
-    const std::string& cname(cspec[cname_cs]);
-    const std::string& title(cspec[title_cs].empty() ? cname : cspec[title_cs]);
-
-    int table_flags = default_summary_table_flags;
-    if (cspec.contains(table_flags_cs)) {
-        table_flags = cspec[table_flags_cs];
-    }
-
-    ImGui::OpenPopup(title.c_str());
+    ImGui::OpenPopup(n.label);
     // Always center this window when appearing
     ImGuiViewport* vp = ImGui::GetMainViewport();
     if (!vp) {
@@ -840,25 +2006,589 @@ void NDContext::render_duck_table_summary_modal(nlohmann::json& w)
     auto center = vp->GetCenter();
     ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, { 0.5, 0.5 });
 
-    int column_count = 0;
-    if (ImGui::BeginPopupModal(title.c_str(), nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
-        // TODO: resolve cname to Arrow ptr
-        std::uint64_t arrow_ptr_val = data[cname];
-        std::shared_ptr<arrow::Table> arrow_table(reinterpret_cast<arrow::Table*>(arrow_ptr_val));
-        const std::shared_ptr<arrow::Schema>& schema(arrow_table->schema());
+    if (ImGui::BeginPopupModal(n.label, nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        // resolve cname handle to a result; our shared_ptr copy keeps it
+        // alive for this frame even if a new result replaces it
+        std::shared_ptr<NDResult> result(get_result(n.slot));
+        if (!result || !result->schema) {
+            ImGui::Text("no result for %s", cname.c_str());
+        }
+        else {
+            const std::shared_ptr<arrow::Schema>& schema(result->schema);
+            ImGui::Text("%lld rows, %d columns%s", result->num_rows, schema->num_fields(),
+                result->complete ? "" : " (streaming)");
+            if (!result->batches.empty()) {
+                auto ttfr = std::chrono::duration_cast<std::chrono::milliseconds>(result->first_row - result->dispatched);
+                ImGui::Text("first row after %lldms", (long long)ttfr.count());
+            }
+            if (ImGui::BeginTable(cname.c_str(), 2, n.flags)) {
+                ImGui::TableSetupColumn("name");
+                ImGui::TableSetupColumn("type");
+                ImGui::TableHeadersRow();
+                for (const auto& field : schema->fields()) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(field->name().c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(field->type()->ToString().c_str());
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::EndPopup();
+    }
+}
+
+
+// render_table cell formatters: see nd_cell_formatter in nodom.hpp
+template <typename ArrayT>
+static void nd_format_number(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text)
+{
+    // to_chars: no locale, no alloc, and shortest round trip for doubles
+    std::to_chars_result rv = std::to_chars(buf, buf + sz, static_cast<const ArrayT&>(col).Value(row));
+    text.begin = buf;
+    text.end = rv.ptr;
+}
+
+template <typename ArrayT>
+static void nd_format_string(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text)
+{
+    // no copy: text points into the arrow value buffer
+    auto view = static_cast<const ArrayT&>(col).GetView(row);
+    text.begin = view.data();
+    text.end = view.data() + view.size();
+}
+
+static void nd_format_bool(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text)
+{
+    static const char* true_cs = "true";
+    static const char* false_cs = "false";
+    text.begin = static_cast<const arrow::BooleanArray&>(col).Value(row) ? true_cs : false_cs;
+    text.end = nullptr;
+}
+
+static void nd_format_decimal(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text)
+{
+    const arrow::Decimal128Array& dec(static_cast<const arrow::Decimal128Array&>(col));
+    const std::int32_t scale = static_cast<const arrow::Decimal128Type&>(*col.type()).scale();
+    arrow::Decimal128 v(dec.GetValue(row));
+    const bool negative = v.IsNegative();
+    if (negative) v.Negate();
+    // unscaled digits: divide 18 at a time off the bottom until the rest
+    // fits a uint64, which for most values is straight away. 10^18 fits a
+    // uint64, and 38 digits leave a uint64 after at most two divisions
+    const arrow::Decimal128 e18(1000000000000000000LL);
+    std::uint64_t chunks[2];
+    int n_chunks = 0;
+    while (v.high_bits() != 0 && n_chunks < 2) {
+        // can't fail: e18 isn't zero
+        std::pair<arrow::Decimal128, arrow::Decimal128> qr(*v.Divide(e18));
+        chunks[n_chunks++] = qr.second.low_bits();
+        v = qr.first;
+    }
+    char digits[ND_CELL_BUF_SZ];
+    char* end = std::to_chars(digits, digits + sizeof(digits), v.low_bits()).ptr;
+    for (int i = n_chunks - 1; i >= 0; i--) {
+        char chunk[20];
+        char* chunk_end = std::to_chars(chunk, chunk + sizeof(chunk), chunks[i]).ptr;
+        std::size_t len = chunk_end - chunk;
+        memset(end, '0', 18 - len);
+        memcpy(end + 18 - len, chunk, len);
+        end += 18;
+    }
+    const std::int32_t n_digits = static_cast<std::int32_t>(end - digits);
+    // arrow switches to exponent notation for negative scales and for
+    // values under 1e-6; those are rare enough to take its allocating path
+    if (scale < 0 || n_digits - 1 - scale < -6) {
+        std::string str(dec.FormatValue(row));
+        std::size_t len = std::min(str.size(), sz - 1);
+        memcpy(buf, str.data(), len);
+        text.begin = buf;
+        text.end = buf + len;
+        return;
+    }
+    // sign, "0.", up to 37 leading zeros and 38 digits fit in ND_CELL_BUF_SZ
+    char* out = buf;
+    if (negative) *out++ = '-';
+    if (scale == 0) {
+        memcpy(out, digits, n_digits);
+        out += n_digits;
+    }
+    else if (n_digits > scale) {
+        memcpy(out, digits, n_digits - scale);
+        out += n_digits - scale;
+        *out++ = '.';
+        memcpy(out, digits + n_digits - scale, scale);
+        out += scale;
+    }
+    else {
+        *out++ = '0';
+        *out++ = '.';
+        memset(out, '0', scale - n_digits);
+        out += scale - n_digits;
+        memcpy(out, digits, n_digits);
+        out += n_digits;
+    }
+    text.begin = buf;
+    text.end = out;
+}
+
+// ISO 8601 in UTC, like JS Date.toISOString in main.ts:render_table
+template <std::int64_t PER_SEC, int DIGITS>
+static void nd_format_timestamp(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text)
+{
+    std::int64_t v = static_cast<const arrow::TimestampArray&>(col).Value(row);
+    std::int64_t secs = v / PER_SEC;
+    std::int64_t frac = v % PER_SEC;
+    if (frac < 0) {
+        frac += PER_SEC;
+        secs--;
+    }
+    std::time_t t = static_cast<std::time_t>(secs);
+    // gmtime's static buffer is fine: single GUI thread
+    std::tm* tm = std::gmtime(&t);
+    text.begin = buf;
+    if (!tm) {
+        text.begin = "?";
+        text.end = nullptr;
+        return;
+    }
+    std::size_t len = std::strftime(buf, sz, "%Y-%m-%dT%H:%M:%S", tm);
+    if (DIGITS) {
+        len += snprintf(buf + len, sz - len, ".%0*lld", DIGITS, static_cast<long long>(frac));
+    }
+    text.end = buf + len;
+}
+
+static void nd_format_date32(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text)
+{
+    std::time_t t = static_cast<std::time_t>(static_cast<const arrow::Date32Array&>(col).Value(row)) * 86400;
+    std::tm* tm = std::gmtime(&t);
+    text.begin = buf;
+    text.end = buf + (tm ? std::strftime(buf, sz, "%Y-%m-%d", tm) : 0);
+}
+
+static void nd_format_scalar(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text)
+{
+    // fallback for types without a fast path: allocates, but
+    // only ever for the visible rows
+    arrow::Result<std::shared_ptr<arrow::Scalar>> scalar(col.GetScalar(row));
+    std::string str(scalar.ok() ? (*scalar)->ToString() : std::string("?"));
+    std::size_t len = std::min(str.size(), sz - 1);
+    memcpy(buf, str.data(), len);
+    text.begin = buf;
+    text.end = buf + len;
+}
+
+static nd_cell_formatter nd_cell_formatter_for(const arrow::DataType& type)
+{
+    switch (type.id()) {
+    case arrow::Type::INT8:         return &nd_format_number<arrow::Int8Array>;
+    case arrow::Type::INT16:        return &nd_format_number<arrow::Int16Array>;
+    case arrow::Type::INT32:        return &nd_format_number<arrow::Int32Array>;
+    case arrow::Type::INT64:        return &nd_format_number<arrow::Int64Array>;
+    case arrow::Type::UINT8:        return &nd_format_number<arrow::UInt8Array>;
+    case arrow::Type::UINT16:       return &nd_format_number<arrow::UInt16Array>;
+    case arrow::Type::UINT32:       return &nd_format_number<arrow::UInt32Array>;
+    case arrow::Type::UINT64:       return &nd_format_number<arrow::UInt64Array>;
+    case arrow::Type::FLOAT:        return &nd_format_number<arrow::FloatArray>;
+    case arrow::Type::DOUBLE:       return &nd_format_number<arrow::DoubleArray>;
+    case arrow::Type::BOOL:         return &nd_format_bool;
+    case arrow::Type::STRING:       return &nd_format_string<arrow::StringArray>;
+    case arrow::Type::LARGE_STRING: return &nd_format_string<arrow::LargeStringArray>;
+    case arrow::Type::DECIMAL128:   return &nd_format_decimal;
+    case arrow::Type::DATE32:       return &nd_format_date32;
+    case arrow::Type::TIMESTAMP:
+        switch (static_cast<const arrow::TimestampType&>(type).unit()) {
+        case arrow::TimeUnit::SECOND:   return &nd_format_timestamp<1, 0>;
+        case arrow::TimeUnit::MILLI:    return &nd_format_timestamp<1000, 3>;
+        case arrow::TimeUnit::MICRO:    return &nd_format_timestamp<1000000, 6>;
+        case arrow::TimeUnit::NANO:     return &nd_format_timestamp<1000000000, 9>;
+        }
+        break;
+    default:
+        break;
+    }
+    return &nd_format_scalar;
+}
+
+
+// Copy a sort/filter result, which may be an array or a chunked array
+// of uint64 row ids, out into a plain row index for the clipper.
+static void nd_append_indices(const arrow::Datum& d, std::vector<std::int64_t>& rows)
+{
+    std::vector<std::shared_ptr<arrow::Array>> chunks;
+    if (d.is_array()) chunks.push_back(d.make_array());
+    else if (d.is_chunked_array()) chunks = d.chunked_array()->chunks();
+    for (const auto& chunk : chunks) {
+        const arrow::UInt64Array& ids(static_cast<const arrow::UInt64Array&>(*chunk));
+        for (std::int64_t i = 0; i < ids.length(); i++) {
+            rows.push_back(static_cast<std::int64_t>(ids.Value(i)));
+        }
+    }
+}
+
+
+// Worker side of NDTableView: build the row permutation for one snapshot
+// of a result. SortIndices does the multi column compare with arrow's
+// typed kernels, so there's no per cell virtual dispatch. The filter is a
+// case insensitive substring match over the string columns, OR'd together.
+// Returns null on an arrow error.
+static nd_row_index nd_build_table_index(std::shared_ptr<arrow::Schema> schema,
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches,
+    std::vector<NDTableSortKey> keys, std::string filter)
+{
+    const static char* method = "nd_build_table_index: ";
+    namespace cp = arrow::compute;
+
+    arrow::Result<std::shared_ptr<arrow::Table>> table_r(arrow::Table::FromRecordBatches(schema, batches));
+    if (!table_r.ok()) {
+        std::cerr << method << table_r.status().ToString() << std::endl;
+        return nullptr;
+    }
+    std::shared_ptr<arrow::Table> table(*table_r);
+    std::shared_ptr<std::vector<std::int64_t>> rows(std::make_shared<std::vector<std::int64_t>>());
+
+    arrow::Datum mask;
+    if (!filter.empty()) {
+        cp::MatchSubstringOptions match(filter, true);
+        for (int c = 0; c < table->num_columns(); c++) {
+            arrow::Type::type id = table->schema()->field(c)->type()->id();
+            if (id != arrow::Type::STRING && id != arrow::Type::LARGE_STRING) continue;
+            arrow::Result<arrow::Datum> col_mask(cp::CallFunction("match_substring", { table->column(c) }, &match));
+            if (!col_mask.ok()) {
+                std::cerr << method << col_mask.status().ToString() << std::endl;
+                return nullptr;
+            }
+            if (mask.kind() == arrow::Datum::NONE) {
+                mask = *col_mask;
+            }
+            else {
+                arrow::Result<arrow::Datum> or_mask(cp::Or(mask, *col_mask));
+                if (!or_mask.ok()) {
+                    std::cerr << method << or_mask.status().ToString() << std::endl;
+                    return nullptr;
+                }
+                mask = *or_mask;
+            }
+        }
+        // no string columns: nothing can match
+        if (mask.kind() == arrow::Datum::NONE) return rows;
+    }
+
+    arrow::Result<arrow::Datum> indices;
+    if (!keys.empty()) {
+        std::vector<cp::SortKey> sort_keys;
+        for (const auto& k : keys) {
+            sort_keys.emplace_back(arrow::FieldRef(k.column),
+                k.ascending ? cp::SortOrder::Ascending : cp::SortOrder::Descending);
+        }
+        arrow::Result<std::shared_ptr<arrow::Array>> sorted(cp::SortIndices(arrow::Datum(table), cp::SortOptions(sort_keys)));
+        if (!sorted.ok()) {
+            std::cerr << method << sorted.status().ToString() << std::endl;
+            return nullptr;
+        }
+        indices = arrow::Datum(*sorted);
+        if (mask.kind() != arrow::Datum::NONE) {
+            // put the mask into sorted order, then drop the misses;
+            // null mask entries count as misses
+            arrow::Result<arrow::Datum> sorted_mask(cp::Take(mask, *indices));
+            if (sorted_mask.ok()) indices = cp::Filter(*indices, *sorted_mask);
+            else indices = sorted_mask;
+        }
+    }
+    else {
+        indices = cp::CallFunction("indices_nonzero", { mask });
+    }
+    if (!indices.ok()) {
+        std::cerr << method << indices.status().ToString() << std::endl;
+        return nullptr;
+    }
+    rows->reserve(static_cast<std::size_t>(table->num_rows()));
+    nd_append_indices(*indices, *rows);
+    return rows;
+}
+
+
+void NDContext::request_table_index(NDTableView& view, NDResult& result)
+{
+    view.generation++;
+    // natural order needs no worker; the generation bump
+    // discards anything still in flight
+    view.rows_requested = result.num_rows;
+    if (view.sort_keys.empty() && !view.filter[0]) {
+        view.rows.reset();
+        view.rows_indexed = result.num_rows;
+        view.pending = false;
+        return;
+    }
+    if (view.busy) {
+        view.pending = true;
+        return;
+    }
+    view.pending = false;
+    // busy is clear, so any previous worker is on its way out
+    if (view.worker.joinable()) view.worker.join();
+    view.busy = true;
+    // rows_indexed stays with the rows on screen until ready replaces them
+    NDTableView* vp = &view;
+    std::uint64_t generation = view.generation;
+    std::int64_t rows_indexed = result.num_rows;
+    // snapshot: batches are immutable, but the vector grows
+    // on the render thread while a result streams in
+    std::shared_ptr<arrow::Schema> schema(result.schema);
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches(result.batches);
+    std::vector<NDTableSortKey> keys(view.sort_keys);
+    std::string filter(view.filter);
+    view.worker = boost::thread([vp, generation, rows_indexed, schema, batches, keys, filter]() {
+        const static char* method = "NDContext::request_table_index: ";
+        auto start = std::chrono::steady_clock::now();
+        nd_row_index rows(nd_build_table_index(schema, batches, keys, filter));
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << method << rows_indexed << " rows indexed in " << elapsed.count() << "ms" << std::endl;
+        if (rows) {
+            boost::mutex::scoped_lock lock(vp->mutex);
+            vp->ready = rows;
+            vp->ready_generation = generation;
+            vp->ready_rows_indexed = rows_indexed;
+        }
+        vp->busy = false;
+    });
+}
+
+
+// Rows on screen: the view's permutation, then any rows that streamed in
+// after it was built, unsorted and unfiltered, until the end of stream
+// re-index takes them in.
+static std::int64_t nd_display_rows(const NDResult& result, const std::vector<std::int64_t>* rows, std::int64_t rows_indexed)
+{
+    return rows ? static_cast<std::int64_t>(rows->size()) + result.num_rows - rows_indexed : result.num_rows;
+}
+
+
+const NDTextBlock& NDContext::text_block(NDResult& result, NDTableView& view, std::int64_t pos)
+{
+    NDTextCache& cache(view.text);
+    if (cache.order != view.rows) {
+        // blocks are in display order, so a new sort or filter voids them
+        cache.stats.evictions += cache.blocks.size();
+        cache.blocks.clear();
+        cache.lru.clear();
+        cache.order = view.rows;
+        cache.tail = view.rows_indexed;
+    }
+    const std::int64_t display_rows = nd_display_rows(result, view.rows.get(), view.rows_indexed);
+    const std::int64_t index = pos / ND_TEXT_BLOCK_ROWS;
+    const std::int64_t first_row = index * ND_TEXT_BLOCK_ROWS;
+    // a streaming result may have grown into a partial block
+    const std::int64_t row_count = std::min<std::int64_t>(ND_TEXT_BLOCK_ROWS, display_rows - first_row);
+    auto it = cache.blocks.find(index);
+    if (it != cache.blocks.end()) {
+        NDTextBlock& block(it->second);
+        cache.lru.splice(cache.lru.begin(), cache.lru, block.lru);
+        if (block.row_count == row_count) {
+            cache.stats.hits++;
+            return block;
+        }
+        block.row_count = row_count;
+        format_text_block(result, cache, block);
+        return block;
+    }
+    if (cache.blocks.size() >= ND_TEXT_CACHE_BLOCKS) {
+        // recycle the LRU block's arena and offsets
+        auto victim = cache.blocks.find(cache.lru.back());
+        cache.spare.arena.swap(victim->second.arena);
+        cache.spare.offsets.swap(victim->second.offsets);
+        cache.blocks.erase(victim);
+        cache.lru.pop_back();
+        cache.stats.evictions++;
     }
- 
+    NDTextBlock& block(cache.blocks[index]);
+    block.arena.swap(cache.spare.arena);
+    block.offsets.swap(cache.spare.offsets);
+    block.first_row = first_row;
+    block.row_count = row_count;
+    cache.lru.push_front(index);
+    block.lru = cache.lru.begin();
+    format_text_block(result, cache, block);
+    return block;
 }
 
 
-void NDContext::render_table(nlohmann::json& w)
+void NDContext::format_text_block(NDResult& result, NDTextCache& cache, NDTextBlock& block)
 {
-    
+    static char cell_buf[ND_CELL_BUF_SZ];
+    NDCellText text;
+    cache.stats.misses++;
+    block.arena.clear();
+    block.offsets.clear();
+    block.offsets.push_back(0);
+    const std::vector<std::int64_t>* order = cache.order.get();
+    const std::int64_t order_size = order ? static_cast<std::int64_t>(order->size()) : 0;
+    const int column_count = static_cast<int>(result.formatters.size());
+    const std::int64_t end_row = block.first_row + block.row_count;
+    for (int c = 0; c < column_count; c++) {
+        std::size_t b = 0;
+        for (std::int64_t pos = block.first_row; pos < end_row; pos++) {
+            // past the permutation is the unindexed tail, in result order
+            const std::int64_t row = !order ? pos : pos < order_size ? (*order)[pos] : cache.tail + pos - order_size;
+            // result order walks forward batch by batch, but a
+            // permutation can jump anywhere, so search per row
+            if (order || pos == block.first_row) {
+                b = std::upper_bound(result.offsets.begin(), result.offsets.end(), row) - result.offsets.begin() - 1;
+            }
+            else {
+                while (b + 1 < result.batches.size() && row >= result.offsets[b + 1]) b++;
+            }
+            const std::int64_t batch_row = row - result.offsets[b];
+            const std::shared_ptr<arrow::Array>& col(result.batches[b]->column(c));
+            // nulls are empty cells
+            if (!col->IsNull(batch_row)) {
+                result.formatters[c](*col, batch_row, cell_buf, ND_CELL_BUF_SZ, text);
+                const char* end = text.end ? text.end : text.begin + strlen(text.begin);
+                block.arena.insert(block.arena.end(), text.begin, end);
+            }
+            block.offsets.push_back(static_cast<std::uint32_t>(block.arena.size()));
+        }
+    }
+    cache.stats.cells += column_count * block.row_count;
 }
 
-void NDContext::push_widget(nlohmann::json& w)
+
+void NDContext::get_text_cache_stats(NDTextCacheStats& stats)
 {
-    stack.push_back(w);
+    for (auto& view : table_views) {
+        const NDTextCacheStats& vs(view->text.stats);
+        stats.hits += vs.hits;
+        stats.misses += vs.misses;
+        stats.evictions += vs.evictions;
+        stats.cells += vs.cells;
+        stats.blocks += view->text.blocks.size();
+    }
+}
+
+
+void NDContext::render_table(NDNode& n)
+{
+    const static char* method = "NDContext::render_table: ";
+
+    // our shared_ptr copy keeps the result alive for this frame
+    // even if a new result for the same query_id replaces it
+    std::shared_ptr<NDResult> result(get_result(n.slot));
+    if (!result || !result->schema) return;
+    NDResult& r(*result);
+    const int column_count = r.schema->num_fields();
+    if (!column_count) {
+        std::cerr << method << *n.cname << ": empty schema" << std::endl;
+        return;
+    }
+    // pick formatters once per schema, not per cell
+    if (r.formatters.size() != static_cast<std::size_t>(column_count)) {
+        r.formatters.clear();
+        for (const auto& field : r.schema->fields()) {
+            r.formatters.push_back(nd_cell_formatter_for(*field->type()));
+        }
+    }
+    NDTableView& view(*n.table);
+    bool index_dirty = false;
+    if (view.handle != r.handle) {
+        // new result: keep sort and filter, drop the old permutation
+        // and the old result's text
+        view.handle = r.handle;
+        view.rows.reset();
+        view.text.stats.evictions += view.text.blocks.size();
+        view.text.blocks.clear();
+        view.text.lru.clear();
+        view.text.order.reset();
+        view.generation++;
+        index_dirty = true;
+    }
+    if (n.options & ND_TABLE_FILTER) {
+        ImGui::PushID(n.cname->c_str());
+        if (ImGui::InputTextWithHint("##filter", "filter", view.filter, ND_FILTER_BUF_SZ)) {
+            index_dirty = true;
+        }
+        ImGui::PopID();
+    }
+    // pick up a finished permutation
+    if (!view.busy) {
+        boost::mutex::scoped_lock lock(view.mutex);
+        if (view.ready && view.ready_generation == view.generation) {
+            view.rows = view.ready;
+            view.rows_indexed = view.ready_rows_indexed;
+        }
+        view.ready.reset();
+    }
+    if (!ImGui::BeginTable(n.cname->c_str(), column_count, n.flags)) return;
+    ImGui::TableSetupScrollFreeze(0, 1);
+    for (const auto& field : r.schema->fields()) {
+        ImGui::TableSetupColumn(field->name().c_str(), ImGuiTableColumnFlags_WidthStretch);
+    }
+    ImGui::TableHeadersRow();
+    ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs();
+    if (specs && specs->SpecsDirty) {
+        view.sort_keys.clear();
+        for (int i = 0; i < specs->SpecsCount; i++) {
+            NDTableSortKey key;
+            key.column = specs->Specs[i].ColumnIndex;
+            key.ascending = specs->Specs[i].SortDirection != ImGuiSortDirection_Descending;
+            view.sort_keys.push_back(key);
+        }
+        specs->SpecsDirty = false;
+        index_dirty = true;
+    }
+    // a streaming result has grown since we indexed it. Re-sorting per
+    // batch would be quadratic in the rows, so rows that stream in after
+    // the last index show unsorted after the indexed ones, and the end of
+    // the stream re-indexes once.
+    bool ordered = !view.sort_keys.empty() || view.filter[0];
+    if (ordered && r.complete && !view.busy && !view.pending && view.rows_requested != r.num_rows) {
+        index_dirty = true;
+    }
+    if (index_dirty || (view.pending && !view.busy)) {
+        request_table_index(view, r);
+    }
+    // poll for the worker's permutation
+    if (view.busy || view.pending) request_animation();
+
+    // only the visible rows are drawn, so frame cost tracks the window
+    // height, not num_rows. Cell text comes from the view's text cache,
+    // which formats a block of rows the first time any is visible. With
+    // a sort or filter in play blocks follow the view's permutation.
+    const NDTextBlock* block = nullptr;
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(nd_display_rows(r, view.rows.get(), view.rows_indexed)));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            // one cache lookup per block per frame, not per row
+            if (!block || i < block->first_row || i >= block->first_row + block->row_count) {
+                block = &text_block(r, view, i);
+            }
+            const char* arena = block->arena.data();
+            const std::int64_t cell = i - block->first_row;
+            ImGui::TableNextRow();
+            for (int c = 0; c < column_count; c++) {
+                ImGui::TableSetColumnIndex(c);
+                const std::uint32_t* offset = &block->offsets[c * block->row_count + cell];
+                if (offset[0] == offset[1]) continue;
+                ImGui::TextUnformatted(arena + offset[0], arena + offset[1]);
+            }
+        }
+    }
+    ImGui::EndTable();
+}
+
+void NDContext::push_widget(NDNodeId id)
+{
+    // a node is on the stack at most once, so the stack can't outgrow
+    // the node count capacity reserved at compile time, and the push
+    // never allocates. The scan is over the stack depth, a handful.
+    if (std::find(stack.begin(), stack.end(), id) != stack.end()) {
+        std::cerr << "push of rname(" << nodes[id].rname << ") already on the stack" << std::endl;
+        return;
+    }
+    stack.push_back(id);
+    request_redraw();
 }
 
 void NDContext::pop_widget(const std::string& rname)
@@ -866,40 +2596,46 @@ void NDContext::pop_widget(const std::string& rname)
     // if rname is empty we pop without checks
     // if rname specifies a class we check the
     //      popped widget rname
+    if (stack.empty()) {
+        std::cerr << "pop on empty stack rname(" << rname << ")" << std::endl;
+        return;
+    }
     if (!rname.empty()) {
-        nlohmann::json& w(stack.back());
-        if (w["rname"] != rname) {
-            std::cerr << "pop mismatch w.rname(" << w["rname"] << ") rname("
+        NDNode& n(nodes[stack.back()]);
+        if (rname != n.rname) {
+            std::cerr << "pop mismatch w.rname(" << n.rname << ") rname("
                 << rname << ")" << std::endl;
         }
-        stack.pop_back();
     }
+    stack.pop_back();
+    request_redraw();
 }
 
-void NDContext::push_font(nlohmann::json& w)
+void NDContext::push_font(NDNode& n)
 {
     const static char* method = "NDContext::push_font: ";
-
-    if (!w.contains(cspec_cs)) {
-        std::cerr << method << "bad cspec in: " << w << std::endl;
-        return;
-    }
-    const nlohmann::json& cspec(w[cspec_cs]);
-    if (!cspec.contains(font_cs)) {
-        std::cerr << method << "no font in cspec: " << w << std::endl;
+    // pop_font only pops what we pushed, so imgui's font stack stays balanced
+    fonts_pushed.push_back(false);
+    if (!n.font_name) {
+        std::cerr << method << "no font in cspec: " << *n.spec << std::endl;
         return;
     }
-    const std::string& font_name(cspec[font_cs]);
-    const auto it = font_map.find(font_name);
-    if (it != font_map.end()) {
-        ImGui::PushFont(it->second);
+    // n.font is resolved by register_font
+    if (n.font) {
+        ImGui::PushFont(n.font);
+        fonts_pushed.back() = true;
     }
     else {
-        std::cerr << method << "unknown font: " << font_name << std::endl;
+        std::cerr << method << "unknown font: " << n.font_name << std::endl;
     }
 }
 
-void NDContext::pop_font(nlohmann::json& w)
+void NDContext::pop_font(NDNode& n)
 {
-    ImGui::PopFont();
-}
\ No newline at end of file
+    if (fonts_pushed.empty()) return;
+    bool pushed = fonts_pushed.back();
+    fonts_pushed.pop_back();
+    if (pushed) {
+        ImGui::PopFont();
+    }
+}
@@ -1,7 +1,16 @@
 #pragma once
 #include <string>
 #include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <deque>
+#include <list>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
 #include "json.hpp"
 #include <pybind11/pybind11.h>
 #include <filesystem>
@@ -10,6 +19,12 @@
 #include <boost/thread.hpp>
 #include <websocketpp/config/asio_no_tls_client.hpp>
 #include <websocketpp/client.hpp>
+#include "nd_ring.hpp"
+#include "nd_cache.hpp"
+#include "nd_profiler.hpp"
+#include "nd_codec.hpp"
+#include "nd_inbound.hpp"
+#include "nd_deflate.hpp"
 
 // NoDOM emulation: debugging ND impls in TS/JS is tricky. Code compiled from C++ to clang .o
 // is not available. So when we port to EM, we have to resort to printf debugging. Not good
@@ -19,11 +34,281 @@
 // C++ code to maintain when we just want to focus on the impl that is opaque in the browser.
 // JOS 2025-01-22
 
-typedef websocketpp::client<websocketpp::config::asio_client> ws_client;
+namespace arrow {
+    class Array;
+    class RecordBatch;
+    class RecordBatchReader;
+    class Schema;
+}
+class NDDuckEngine;
+
+typedef websocketpp::client<nd_ws_config> ws_client;
 
-#define ND_MAX_COMBO_LIST 16
 #define ND_WC_BUF_SZ 256
 
+// snapshot of python_thread batching counters: each batch costs one GIL
+// acquisition, and messages - py_calls is the number of python calls the
+// batched on_data_changes entry point saved us
+struct NDBatchStats {
+    std::uint64_t   batches = 0;
+    std::uint64_t   messages = 0;
+    std::uint64_t   py_calls = 0;
+    std::uint64_t   notifications = 0;  // notify_server calls
+    std::uint64_t   coalesced = 0;      // notifications merged into a pending DataChange
+    std::uint64_t   packed_bytes = 0;   // DataChange bytes across the py boundary
+    std::uint64_t   patches = 0;        // DataChanges sent as a DataPatch diff
+    std::uint64_t   patch_bytes_saved = 0;
+    std::int64_t    diff_us = 0;        // cumulative json::diff time
+    NDEncoding      py_encoding = ND_ENC_JSON;
+};
+
+// snapshot of notify_server to dispatch_server_responses latency, and
+// of the part of it up to arrival in the inbound stage
+struct NDLatencyStats {
+    std::uint64_t   samples = 0;
+    std::int64_t    p50_us = 0;
+    std::int64_t    p99_us = 0;
+    std::int64_t    staged_p50_us = 0;
+    std::int64_t    staged_p99_us = 0;
+};
+
+// rolling window of microsecond samples; cpp thread only
+#define ND_LATENCY_WINDOW 1024
+
+struct NDLatencySampler {
+    std::int64_t    window[ND_LATENCY_WINDOW] = {};
+    std::int64_t    scratch[ND_LATENCY_WINDOW] = {};  // no heap alloc per query
+    std::uint64_t   count = 0;
+
+    void add(std::int64_t us) { window[count++ % ND_LATENCY_WINDOW] = us; }
+    std::int64_t percentile(double p) {
+        std::size_t n = count < ND_LATENCY_WINDOW ? count : ND_LATENCY_WINDOW;
+        if (!n) return 0;
+        std::copy(window, window + n, scratch);
+        std::int64_t* nth = scratch + static_cast<std::size_t>(p * (n - 1));
+        std::nth_element(scratch, nth, scratch + n);
+        return *nth;
+    }
+};
+
+// C++ <-> py work item; stamp is the notify_server/duck_dispatch
+// time of the request, carried through to its responses
+struct NDWorkItem {
+    nlohmann::json                          msg;
+    std::chrono::steady_clock::time_point   stamp;
+};
+
+typedef std::function<void()> nd_response_callback;
+
+// An execution lane: its own work Q, response Q and py thread. Lane 0 is
+// the low latency DataChange lane; DB requests go to the duck lanes so a
+// slow ParquetScan or Query can't block UI DataChanges behind it.
+// Response ordering is preserved within a lane, not across lanes, so
+// DB requests share duck0 unless a layout db op sets a lane_key to say
+// it's independent of requests with other lane_keys. See lane_for.
+struct NDLane {
+    NDLane(const std::string& n, std::size_t i)
+        :name(n), index(i), busy(false), batches(0), messages(0), py_calls(0),
+        packed_bytes(0), last_wait_us(0), max_wait_us(0), last_exec_us(0) {}
+
+    std::string                         name;
+    std::size_t                         index;          // 0 is the DataChange lane
+    NDRingBuffer<NDWorkItem>            to_python;      // cpp thread -> lane
+    NDRingBuffer<NDWorkItem>            from_python;    // lane -> cpp thread
+    boost::mutex                        to_mutex;
+    boost::condition_variable           to_cond;
+    boost::thread                       thread;
+    boost::atomic<bool>                 busy;           // servicing a batch
+    // gauges: written by the lane thread, read by the cpp thread
+    boost::atomic<std::uint64_t>        batches;
+    boost::atomic<std::uint64_t>        messages;
+    boost::atomic<std::uint64_t>        py_calls;
+    boost::atomic<std::uint64_t>        packed_bytes;   // py_encoding bytes both ways
+    boost::atomic<std::int64_t>         last_wait_us;   // oldest msg Q time in last batch
+    boost::atomic<std::int64_t>         max_wait_us;
+    boost::atomic<std::int64_t>         last_exec_us;   // time to service last batch
+    NDWorkItem                          held;           // cpp thread: refused by a full inbound stage
+    bool                                holding = false;
+    std::deque<NDWorkItem>              parked;         // cpp thread: refused by a full to_python
+    std::chrono::steady_clock::time_point batch_stamp;  // lane thread only
+};
+
+// snapshot of NDLane gauges for the Footer
+struct NDLaneStats {
+    std::string     name;
+    std::size_t     depth = 0;
+    std::uint64_t   batches = 0;
+    std::uint64_t   messages = 0;
+    std::int64_t    last_wait_us = 0;
+    std::int64_t    max_wait_us = 0;
+    std::int64_t    last_exec_us = 0;
+};
+
+// DataChange held back in notify_server while the py thread is busy
+struct NDCoalescedChange {
+    nlohmann::json                          old_value;  // first seen
+    nlohmann::json                          new_value;  // latest
+    std::chrono::steady_clock::time_point   stamp;      // first notify
+};
+
+#define ND_COALESCE_MAX_DELAY_MS 50
+
+// DataPatch: a DataChange carrying an RFC 6902 patch in place of
+// new_value. Outbound, values with at least patch_min_elements elements
+// are diffed against old_value, and go as a DataPatch when the patch is
+// the smaller. 0 switches it off, which suits py services that don't
+// handle DataPatch.
+#define ND_PATCH_MIN_ELEMENTS 0
+
+// inbound DataPatch gauges: cpp thread only
+struct NDPatchStats {
+    std::uint64_t   patches = 0;
+    std::uint64_t   ops = 0;
+    std::uint64_t   failures = 0;
+    std::int64_t    apply_us = 0;       // cumulative
+};
+
+// Staging area for Arrow record batches crossing from the lanes to the
+// cpp thread: a lane stages a batch and sends its handle in a
+// QueryResultBatch msg, and NDContext::on_duck_event takes it.
+class NDArrowHandoff {
+public:
+    std::uint64_t                       stage(std::shared_ptr<arrow::RecordBatch> batch);
+    std::shared_ptr<arrow::RecordBatch> take(std::uint64_t handle);
+
+private:
+    boost::mutex                        mutex;
+    std::uint64_t                       next_handle = 1;
+    std::unordered_map<std::uint64_t, std::shared_ptr<arrow::RecordBatch>> staged;
+};
+
+// render_table cell formatting: one formatter per column, chosen from the
+// arrow type once per schema, so the per cell cost is an indirect call.
+// Formatters either point text into the column's own buffers (strings) or
+// write into buf, and never allocate for the common types.
+#define ND_CELL_BUF_SZ 64
+
+struct NDCellText {
+    const char* begin = "";
+    const char* end = nullptr;
+};
+
+typedef void (*nd_cell_formatter)(const arrow::Array& col, std::int64_t row, char* buf, std::size_t sz, NDCellText& text);
+
+// Formatted cell text cache. render_table formats a block of
+// ND_TEXT_BLOCK_ROWS rows the first time any of them is visible, column
+// by column into one contiguous arena, with offsets marking each cell.
+// Scrolling back over rows already seen is then a lookup with no
+// formatting. Blocks hold rows in display order: through the table's
+// sort|filter permutation if it has one, so a sorted view formats only
+// the blocks on screen, not a block per visible row. A new permutation
+// drops the blocks. Blocks are LRU evicted past ND_TEXT_CACHE_BLOCKS,
+// and the evicted block's storage is reused. Each Table's NDTableView
+// has its own cache, so two Tables sorted differently over one result
+// don't void each other's blocks. A new result empties it.
+#define ND_TEXT_BLOCK_ROWS      256
+#define ND_TEXT_CACHE_BLOCKS    64
+
+struct NDTextBlock {
+    std::int64_t                first_row = 0;      // display order
+    std::int64_t                row_count = 0;
+    std::vector<char>           arena;
+    // column major: cell (row, col) is arena[offsets[i], offsets[i + 1])
+    // where i = col * row_count + row - first_row
+    std::vector<std::uint32_t>  offsets;
+    std::list<std::int64_t>::iterator lru;
+};
+
+struct NDTextCacheStats {
+    std::uint64_t   hits = 0;       // block lookups served from the cache
+    std::uint64_t   misses = 0;     // block lookups that formatted
+    std::uint64_t   evictions = 0;
+    std::uint64_t   cells = 0;      // cells formatted
+    std::uint64_t   blocks = 0;     // blocks resident
+};
+
+struct NDTextCache {
+    std::unordered_map<std::int64_t, NDTextBlock>   blocks;     // block index -> block
+    std::shared_ptr<const std::vector<std::int64_t>> order;     // permutation blocks follow, null for result order
+    std::int64_t                                    tail = 0;   // first result row after order's, see render_table
+    std::list<std::int64_t>                         lru;        // most recent at front
+    NDTextBlock                                     spare;      // evicted storage for reuse
+    NDTextCacheStats                                stats;
+};
+
+// A query result as it streams in on the cpp thread. offsets holds the
+// first row of each batch, so row r lives in the batch found by
+// upper_bound on offsets. Only the cpp thread touches an NDResult.
+struct NDResult {
+    std::string                                         query_id;
+    std::uint64_t                                       handle = 0;     // data cache value
+    std::shared_ptr<arrow::Schema>                      schema;
+    std::vector<std::shared_ptr<arrow::RecordBatch>>    batches;
+    std::vector<std::int64_t>                           offsets;
+    std::int64_t                                        num_rows = 0;
+    bool                                                complete = false;
+    std::vector<nd_cell_formatter>                      formatters;     // render_table: one per field
+    // time to first row instrumentation
+    std::chrono::steady_clock::time_point               dispatched;
+    std::chrono::steady_clock::time_point               first_row;
+    std::chrono::steady_clock::time_point               completed;
+};
+
+// Client side sort and filter for a Table widget. Sort specs or filter
+// changes are handed to a background boost::thread that computes a row
+// permutation with arrow::compute over a snapshot of the result batches.
+// rows stays on screen until the new permutation is ready, so the table
+// never blanks mid sort. At most one worker runs per view: a change
+// while it's busy just marks pending, and the latest request wins.
+#define ND_FILTER_BUF_SZ 128
+
+struct NDTableSortKey {
+    int     column = 0;
+    bool    ascending = true;
+};
+
+typedef std::shared_ptr<const std::vector<std::int64_t>> nd_row_index;
+
+struct NDTableView {
+    ~NDTableView() { if (worker.joinable()) worker.join(); }
+
+    // render thread only
+    char                        filter[ND_FILTER_BUF_SZ] = {};
+    std::vector<NDTableSortKey> sort_keys;
+    std::uint64_t               handle = 0;         // result the rows apply to
+    nd_row_index                rows;               // null: natural order
+    std::int64_t                rows_indexed = 0;   // result num_rows when rows was built
+    std::int64_t                rows_requested = 0; // result num_rows at the last request
+    std::uint64_t               generation = 0;     // bumped per request
+    NDTextCache                 text;               // formatted cells, in this view's order
+    bool                        pending = false;    // request waiting on a busy worker
+    boost::thread               worker;
+    boost::atomic<bool>         busy{ false };
+    // worker to render thread handoff
+    boost::mutex                mutex;
+    nd_row_index                ready;
+    std::uint64_t               ready_generation = 0;
+    std::int64_t                ready_rows_indexed = 0;
+};
+
+// Combo item table. Built once per change of the list in the data cache,
+// detected by the NDCache slot version, not per frame. items point into
+// the cached JSON strings, which stay put until the list is replaced.
+// sorted is a case insensitive ordering of item ids, so a typed prefix
+// resolves to the contiguous range [match_begin, match_end) with two
+// binary searches. The popup renders through ImGuiListClipper, so there's
+// no cap on item count.
+#define ND_COMBO_VISIBLE_ITEMS  12
+
+struct NDComboView {
+    std::uint64_t               version = ~0ull;    // NDCache version items were built from
+    std::vector<const char*>    items;
+    std::vector<std::uint32_t>  sorted;             // prefix index
+    char                        filter[ND_FILTER_BUF_SZ] = {};
+    std::size_t                 match_begin = 0;    // into sorted
+    std::size_t                 match_end = 0;
+};
+
 class NDServer {
 public:             // All public methods exec on the cpp thread
 
@@ -37,24 +322,65 @@ public:             // All public methods exec on the cpp thread
     // cpp thread
     void            notify_server(const std::string& caddr, nlohmann::json& old_val, nlohmann::json& new_val);
     void            duck_dispatch(nlohmann::json& db_request);
-    void            get_server_responses(std::queue<nlohmann::json>& responses);
-    void            set_done(bool d) { done = d; }
+    void            flush_notifications(bool force);
+    // from_python rings into the inbound stage: true if anything is staged
+    bool            pull_server_responses();
+    bool            next_server_response(nlohmann::json& msg, std::chrono::steady_clock::time_point& stamp) {
+        return inbound.pop(msg, stamp);
+    }
+    // after dispatch of a response to the request stamped at stamp
+    void            sample_dispatch(std::chrono::steady_clock::time_point stamp) {
+        latency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - stamp).count());
+    }
+    NDInboundStats  get_inbound_stats() { return inbound.get_stats(); }
+    void            set_done(bool d);
     nlohmann::json  get_breadboard_config() { return bb_config; }
+    NDBatchStats    get_batch_stats();
+    NDLatencyStats  get_latency_stats();
+    void            get_lane_stats(std::vector<NDLaneStats>& stats);
+    std::shared_ptr<arrow::RecordBatch> take_batch(std::uint64_t handle) { return handoff.take(handle); }
+    // any thread: the handoff is locked
+    std::uint64_t   stage_batch(std::shared_ptr<arrow::RecordBatch> batch) { return handoff.stage(batch); }
+    // invoked on the py thread when responses are ready; the callee
+    // must hand off to the cpp thread eg with io_service::post. Register
+    // before the first notify_server or duck_dispatch.
+    void            register_response_callback(nd_response_callback cb) { response_callback = cb; }
 
 protected:
     // cpp thread
     bool load_json();
+    NDLane& lane_for(const nlohmann::json& msg);
+    nlohmann::json data_change_msg(const std::string& caddr, nlohmann::json old_val, nlohmann::json new_val);
+    void enqueue_python(nlohmann::json& msg, std::chrono::steady_clock::time_point stamp);
+    void unpark_python();
+    void wake_python(NDLane& lane);
 
-    // py thread
+    // py threads
+    void publish_python(NDLane& lane, nlohmann::json& resp, std::chrono::steady_clock::time_point stamp);
     bool init_python();
     bool fini_python();
     void python_thread();
-    void marshall_server_responses(pybind11::list& server_changes_p, nlohmann::json& server_changes_j,
+    void lane_loop(NDLane* lane);
+    void service_batch(NDLane& lane, std::vector<nlohmann::json>& batch, nlohmann::json& response_list_j);
+    void flush_data_changes(NDLane& lane, pybind11::list& data_changes_p, nlohmann::json& response_list_j, std::uint64_t& py_calls);
+    void flush_packed_changes(NDLane& lane, nlohmann::json& data_changes_j, nlohmann::json& response_list_j, std::uint64_t& py_calls);
+    std::shared_ptr<arrow::RecordBatchReader> import_arrow_result(const std::string& qid, pybind11::object result_p);
+    void stream_arrow_result(NDLane& lane, const std::string& qid, std::shared_ptr<arrow::RecordBatchReader> reader,
+                                    nlohmann::json& response_list_j);
+#ifdef ND_NATIVE_DUCK
+    void native_request(NDLane& lane, nlohmann::json& msg, nlohmann::json& response_list_j);
+#endif
+    void marshall_server_responses(NDLane& lane, pybind11::list& server_changes_p, nlohmann::json& server_changes_j,
                                     const std::string& type_filter);
 
 private:
     nlohmann::json                      bb_config;
     pybind11::object                    on_data_change_f;
+    pybind11::object                    on_data_changes_f;  // optional batched on_data_change
+    pybind11::object                    on_data_changes_packed_f;   // optional, used when py_encoding is binary
+    NDEncoding                          py_encoding;
+    std::string                         packed_buf;     // lane 0 only: DataChanges are never on a duck lane
     pybind11::object                    duck_request_f;
     bool                                is_duck_app;
     char*                               exe;    // argv[0]
@@ -69,18 +395,138 @@ private:
 
     std::map<std::string, std::string>  json_map;
 
-    // queues, mutexes and condition for managing C++ to python work
-    std::queue<nlohmann::json>          to_python;
-    std::queue<nlohmann::json>          from_python;
-    boost::mutex                        to_mutex;
-    boost::mutex                        from_mutex;
-    boost::condition_variable           to_cond;
-    boost::condition_variable           from_cond;
+    // execution lanes, each with lock free SPSC rings for C++ to python
+    // work and python to C++ responses. Lane to_mutex and to_cond are only
+    // used to park the lane thread; the cpp thread never waits on them.
+    std::vector<std::unique_ptr<NDLane>> lanes;
     boost::atomic<bool>                 done;
-    boost::thread                       py_thread;
+    PyThreadState*                      main_tstate;    // GIL released by py_thread after init
+
+    // DataChange coalescing: cpp thread only
+    int                                 coalesce_max_delay_ms;
+    std::set<std::string>               coalesce_opt_out;
+    std::unordered_map<std::string, NDCoalescedChange> coalesced;
+    std::vector<std::string>            coalesced_order;
+    std::chrono::steady_clock::time_point coalesce_start;
+    std::uint64_t                       notify_count;
+    std::uint64_t                       coalesced_count;
+    // inbound stage: cpp thread only
+    NDInbound                           inbound;
+    std::set<std::string>               inbound_opt_out;
+    std::size_t                         patch_min_elements;
+    std::uint64_t                       patch_count;
+    std::uint64_t                       patch_bytes_saved;
+    std::int64_t                        patch_diff_us;
+
+    NDArrowHandoff                      handoff;    // record batches in flight to the cpp thread
+#ifdef ND_NATIVE_DUCK
+    std::unique_ptr<NDDuckEngine>       native_duck;    // replaces duck_request_f on the duck lanes
+#endif
+
+    nd_response_callback                response_callback;
+    NDLatencySampler                    latency;    // cpp thread only
+    NDLatencySampler                    stage_latency;  // to inbound stage arrival
+    boost::thread                       py_thread;      // init, then serves lane 0
 };
 
-typedef std::function<void(const std::string&)> ws_sender;
+// encoding for the wire is the websock client's business: it's only
+// settled once the connection is open
+typedef std::function<void(const nlohmann::json&)> ws_sender;
+
+// Compiled layout. NDContext turns the layout JSON into a flat vector of
+// NDNodes once at construction time, so a steady state frame does no JSON
+// lookups on cspec and no heap allocation. Each node carries its resolved
+// render func, interned strings and parsed cspec values; children are
+// contiguous in the vector, held as the index range [child_begin, child_end).
+typedef std::uint32_t NDNodeId;
+
+class NDContext;
+struct NDNode;
+typedef void (NDContext::*nd_render_func)(NDNode& n);
+
+// Footer cspec options, parsed into NDNode::options
+#define ND_FOOTER_DB        0x01
+#define ND_FOOTER_FPS       0x02
+#define ND_FOOTER_DEMO      0x04
+#define ND_FOOTER_ID_STACK  0x08
+#define ND_FOOTER_MEMORY    0x10
+#define ND_FOOTER_PY        0x20
+#define ND_FOOTER_TABLES    0x40
+#define ND_FOOTER_PROFILER  0x80
+
+// Table cspec options
+#define ND_TABLE_FILTER     0x01
+
+struct NDNode {
+    nd_render_func      render = nullptr;   // null if rname unknown
+    const char*         rname = "";
+    const char*         label = "";         // cspec label, title or text
+    const char*         action = "";        // Button: cspec text, the action_dispatch key
+    const std::string*  cname = nullptr;    // data cache key
+    const std::string*  index = nullptr;    // data cache key for Combo selection
+    NDSlot              slot = ND_NO_SLOT;          // data cache slot for cname
+    NDSlot              index_slot = ND_NO_SLOT;    // data cache slot for index
+    const char*         font_name = nullptr;
+    ImFont*             font = nullptr;     // bound by register_font
+    float               font_size_base = 0.0f;
+    int                 step = 1;
+    int                 step_fast = 1;
+    int                 flags = 0;          // InputInt flags or table_flags
+    std::uint32_t       options = 0;        // ND_FOOTER_* or ND_TABLE_*
+    NDTableView*        table = nullptr;    // Table sort and filter state
+    NDComboView*        combo = nullptr;    // Combo item table
+    NDNodeId            child_begin = 0;
+    NDNodeId            child_end = 0;
+    nlohmann::json*     spec = nullptr;     // source layout JSON, for diagnostics
+};
+
+// Idle mode: main.cpp only renders a frame when needs_frame() says so, or
+// there's GLFW input. Anything that changes what's on screen asks for
+// ND_REDRAW_FRAMES frames via request_redraw; more than one, as imgui
+// needs a frame or two to settle hover and layout after a change. Widgets
+// that animate, like the parquet loading spinner, call request_animation
+// while rendering to get the next frame too.
+#define ND_REDRAW_FRAMES    3
+#define ND_CPU_SAMPLE_MS    1000
+#define ND_FRAME_HIST_BUCKETS 10        // see nd_frame_hist_ms in nodom.cpp
+
+// websocket connection state, published by NDWebSockClient's I/O thread
+enum NDWSState {
+    ND_WS_DISCONNECTED,     // or backing off before a reconnect
+    ND_WS_CONNECTING,
+    ND_WS_OPEN
+};
+
+struct NDWSStatus {
+    NDWSState       state = ND_WS_DISCONNECTED;
+    std::uint64_t   connect_attempts = 0;
+    std::uint64_t   connects = 0;
+    std::uint64_t   dropped = 0;        // outbound msgs dropped while disconnected
+    std::size_t     queued = 0;         // outbound msgs waiting for open
+    std::int64_t    rtt_us = 0;         // last ping/pong round trip
+    NDEncoding      encoding = ND_ENC_JSON; // negotiated subprotocol
+    std::uint64_t   msgs_in = 0;
+    std::uint64_t   bytes_in = 0;       // payload bytes, before decode
+    std::uint64_t   bytes_out = 0;      // payload bytes, after encode
+    std::int64_t    decode_us = 0;      // cumulative decode time on the I/O thread
+    std::uint64_t   ipc_frames = 0;     // NDAR Arrow IPC frames
+    std::uint64_t   ipc_rows = 0;
+    NDDeflateStats  deflate;
+};
+
+struct NDFrameStats {
+    std::uint64_t   frames = 0;         // frames rendered
+    std::uint64_t   idle_waits = 0;     // ticks spent blocked in glfwWaitEventsTimeout
+    std::uint64_t   skipped = 0;        // frame deadlines missed by the pacer
+    int             target_fps = 0;
+    double          cpu_pct = 0.0;      // process CPU over the last sample window
+    // inbound websock msgs, see NDWebSockClient::drain_ws_messages
+    std::uint64_t   ws_messages = 0;
+    std::size_t     ws_backlog_max = 0;
+    std::uint64_t   ws_full_waits = 0;  // I/O thread waits on a full ring
+    // frame to frame interval histogram, bucketed by nd_frame_hist_ms
+    std::uint64_t   frame_hist[ND_FRAME_HIST_BUCKETS] = {};
+};
 
 class NDContext {
 public:
@@ -88,10 +534,18 @@ public:
     void render();                              // invoked by main loop
 
     void notify_server(const std::string& caddr, nlohmann::json& old_val, nlohmann::json& new_val);
-    void dispatch_server_responses(std::queue<nlohmann::json>& responses);
-    void get_server_responses(std::queue<nlohmann::json>& responses);
+    // pull as responses land, dispatch once per frame
+    void pull_server_responses() { if (server.pull_server_responses()) request_redraw(); }
+    void dispatch_server_responses();
+    NDInboundStats get_inbound_stats() { return server.get_inbound_stats(); }
 
     bool duck_app() { return server.duck_app(); }
+    NDBatchStats get_batch_stats() { return server.get_batch_stats(); }
+    void get_lane_stats(std::vector<NDLaneStats>& stats) { server.get_lane_stats(stats); }
+    NDLatencyStats get_latency_stats() { return server.get_latency_stats(); }
+    void register_response_callback(nd_response_callback cb) { server.register_response_callback(cb); }
+    // websock I/O thread: batches decoded from Arrow IPC frames
+    std::uint64_t stage_batch(std::shared_ptr<arrow::RecordBatch> batch) { return server.stage_batch(batch); }
     void set_done(bool d) { server.set_done(d); }
 
     void on_duck_event(nlohmann::json& duck_msg);
@@ -100,12 +554,49 @@ public:
 
     void register_ws_callback(ws_sender send) { ws_send = send; }
 
-    void register_font(const std::string& name, ImFont* f) { font_map[name] = f; }
+    void register_font(const std::string& name, ImFont* f);
+
+    // main.cpp headless harness
+    void dispatch_query(const std::string& nd_type, const std::string& sql, const std::string& qid) {
+        duck_dispatch(nd_type, sql, qid);
+    }
+    std::shared_ptr<NDResult> find_result(const std::string& qid) { return get_result(qid + "_result"); }
+    std::size_t node_count() const { return nodes.size(); }
+
+    // idle mode
+    void request_redraw() { redraw_frames = ND_REDRAW_FRAMES; }
+    void request_animation() { animating = true; }
+    bool needs_frame();
+    void count_idle_wait() { frame_stats.idle_waits++; }
+    void count_skipped_frames(std::int64_t n) { frame_stats.skipped += n; }
+    void set_target_fps(int fps) { frame_stats.target_fps = fps; }
+    void record_frame_time(std::int64_t us);
+    void set_ws_status(const NDWSStatus& status);
+    void record_ws_drain(std::uint64_t drained, std::size_t backlog, std::uint64_t full_waits) {
+        frame_stats.ws_messages += drained;
+        frame_stats.ws_backlog_max = std::max(frame_stats.ws_backlog_max, backlog);
+        frame_stats.ws_full_waits = full_waits;
+    }
+    const NDFrameStats& get_frame_stats() { return frame_stats; }
+    const NDPatchStats& get_patch_stats() { return patch_stats; }
 
 protected:
-    void dispatch_render(nlohmann::json& w);        // w["rname"] resolve & invoke
+    void sample_cpu();
+#ifdef ND_PROFILER
+    void profile_paths(NDNodeId id, const std::string& parent);
+    void render_profiler();
+#endif
+
+    // layout compilation: ctor only
+    NDNodeId compile_widget(nlohmann::json& w);
+    void compile_children(NDNodeId parent, nlohmann::json& children);
+    void compile_node(NDNodeId id, nlohmann::json& w);
+    const std::string* intern(const std::string& s);
+
+    void dispatch_render(NDNode& n);                // n.render invoke
     void action_dispatch(const std::string& action, const std::string& nd_event);
-    void duck_dispatch(const std::string& nd_type, const std::string& sql, const std::string& qid);
+    void duck_dispatch(const std::string& nd_type, const std::string& sql, const std::string& qid,
+                        const std::string& lane_key = "");
     // Render funcs are members of NDContext, unlike in main.ts
     // Why? Separate standalone funcs like in main.ts cause too much
     // hassle with dispatch_render passing this and templating
@@ -113,46 +604,72 @@ protected:
     // with std::bind, std::function etc. So the main.ts and
     // cpp will be different shapes, but hopefully with identical
     // decoupling profiles. JOS 2025-01-24
-    void render_home(nlohmann::json& w);
-    void render_input_int(nlohmann::json& w);
-    void render_combo(nlohmann::json& w);
-    void render_separator(nlohmann::json& w);
-    void render_footer(nlohmann::json& w);
-    void render_same_line(nlohmann::json& w);
-    void render_date_picker(nlohmann::json& w);
-    void render_text(nlohmann::json& w);
-    void render_button(nlohmann::json& w);
-    void render_duck_table_summary_modal(nlohmann::json& w);
-    void render_duck_parquet_loading_modal(nlohmann::json& w);
-    void render_table(nlohmann::json& w);
-
-    void push_widget(nlohmann::json& w);
+    void render_home(NDNode& n);
+    void render_input_int(NDNode& n);
+    void render_combo(NDNode& n);
+    void render_separator(NDNode& n);
+    void render_footer(NDNode& n);
+    void render_same_line(NDNode& n);
+    void render_date_picker(NDNode& n);
+    void render_text(NDNode& n);
+    void render_button(NDNode& n);
+    void render_duck_table_summary_modal(NDNode& n);
+    void render_duck_parquet_loading_modal(NDNode& n);
+    void render_table(NDNode& n);
+    void request_table_index(NDTableView& view, NDResult& result);
+    void build_combo_items(NDComboView& view, const nlohmann::json& list);
+    void filter_combo_items(NDComboView& view);
+    const NDTextBlock& text_block(NDResult& result, NDTableView& view, std::int64_t pos);
+    void format_text_block(NDResult& result, NDTextCache& cache, NDTextBlock& block);
+    void get_text_cache_stats(NDTextCacheStats& stats);
+
+    void push_widget(NDNodeId id);
     void pop_widget(const std::string& rname = "");
 
-    void push_font(nlohmann::json& w);
-    void pop_font(nlohmann::json& w);
+    void apply_patch(nlohmann::json& msg);
+
+    void push_font(NDNode& n);
+    void pop_font(NDNode& n);
+
+    NDResult& open_result(const std::string& qid);
+    bool superseded(const std::string& qid);
+    std::shared_ptr<NDResult> get_result(const std::string& cname);
+    std::shared_ptr<NDResult> get_result(NDSlot slot);
 private:
     // ref to "server process"; in reality it's just a Service class instance
     // with no event loop and synchornous dispatch across c++py boundary
     NDServer&                           server;
     
     nlohmann::json                      layout; // layout and data are fetched by 
-    nlohmann::json                      data;   // sync c++py calls not HTTP gets
-    std::deque<nlohmann::json>          stack;  // render stack
+    NDCache                             data;   // sync c++py calls not HTTP gets
+    std::vector<NDNode>                 nodes;  // compiled layout
+    std::unordered_set<std::string>     strings;    // interned layout strings
+    std::vector<NDNodeId>               stack;  // render stack: ids into nodes
 
     // map layout render func names to the actual C++ impls
-    std::unordered_map<std::string, std::function<void(nlohmann::json& w)>> rfmap;
+    std::unordered_map<std::string, nd_render_func> rfmap;
 
     // top level layout widgets with widget_id eg modals are in pushables
-    std::unordered_map<std::string, nlohmann::json> pushable;
-    // main.ts:action_dispatch is called while rendering, and changes
-    // the size of the render stack. JS will let us do that in the root
-    // render() method. But in C++ we use an STL iterator in the root render
-    // method, and that segfaults. So in C++ we have pending pushes done
-    // outside the render stack walk. JOS 2025-01-31
-    std::deque<nlohmann::json> pending_pushes;
-    std::deque<std::string> pending_pops;
+    std::unordered_map<std::string, NDNodeId> pushable;
     bool    show_id_stack = false;
+    bool    show_demo_window = false;   // Footer demo checkbox
+#ifdef ND_PROFILER
+    // F9 dumps a Chrome trace of the last ND_PROFILE_TRACE_FRAMES frames
+    NDProfiler                  profiler;
+    bool                        show_profiler = false;  // Footer profiler checkbox
+    bool                        profile_by_rname = false;
+    std::vector<std::uint32_t>  profile_rows;           // overlay sort scratch
+#endif
+
+    // idle mode
+    int                                     redraw_frames = ND_REDRAW_FRAMES;
+    bool                                    animating = false;
+    NDFrameStats                            frame_stats;
+    NDWSStatus                              ws_status;
+    NDPatchStats                            patch_stats;
+    nlohmann::json                          server_resp;    // dispatch_server_responses scratch
+    std::chrono::steady_clock::time_point   cpu_sample_wall;
+    std::int64_t                            cpu_sample_ns = 0;
 
     // colours: https://www.w3schools.com/colors/colors_picker.asp
     ImColor red;    // ImGui.COL32(255, 51, 0);
@@ -161,6 +678,22 @@ private:
     ImColor db_status_color;
 
     std::map<std::string, ImFont*>  font_map;
+    std::vector<bool>               fonts_pushed;   // per open PushFont: did it push, for PopFont
+
+    std::vector<NDLaneStats>        lane_stats;     // Footer scratch
+
+    // owns the NDNode::table views for Table widgets
+    std::vector<std::unique_ptr<NDTableView>>   table_views;
+    // owns the NDNode::combo views for Combo widgets
+    std::vector<std::unique_ptr<NDComboView>>   combo_views;
+
+    // query results: data["<query_id>_result"] holds a handle into results
+    std::unordered_map<std::uint64_t, std::shared_ptr<NDResult>> results;
+    std::unordered_map<std::string, std::uint64_t> streaming;   // query_id -> open result
+    // query_id -> dispatch time of each request yet to end, oldest first:
+    // all but the last were re-dispatched over, see duck_dispatch
+    std::unordered_map<std::string, std::deque<std::chrono::steady_clock::time_point>> query_dispatched;
+    std::uint64_t next_result_handle = 1;
 
     // default value for invoking std::find on nlohmann JSON iterators
     std::string null_value = "null_value";